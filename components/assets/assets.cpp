@@ -0,0 +1,135 @@
+#include <cstring>
+
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#include "assets.h"
+
+static const char *TAG = "assets";
+
+#define ASSETS_MAX_COUNT 256
+
+static const uint8_t *s_base = NULL;
+static const assets_header_t *s_header = NULL;
+static const assets_toc_entry_t *s_toc = NULL;
+static spi_flash_mmap_handle_t s_mmap;
+/*! \brief Assets whose CRC was checked, by TOC index. */
+static uint32_t s_verified[ASSETS_MAX_COUNT / 32];
+
+static uint32_t crc32(const void *data, size_t size) {
+  return esp_rom_crc32_le(0, static_cast<const uint8_t *>(data), size);
+}
+
+int assets_init() {
+  const esp_partition_t *part = esp_partition_find_first(
+    ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, ASSETS_PARTITION);
+  if (part == NULL) {
+    ESP_LOGE(TAG, "No %s partition", ASSETS_PARTITION);
+    return -1;
+  }
+  assets_header_t header;
+  if (esp_partition_read(part, 0, &header, sizeof(header)) != ESP_OK) {
+    ESP_LOGE(TAG, "Unable to read header");
+    return -1;
+  }
+  const size_t toc_size = header.count * sizeof(assets_toc_entry_t);
+  if (header.magic != ASSETS_MAGIC || header.version != ASSETS_VERSION ||
+      header.count > ASSETS_MAX_COUNT || header.size > part->size ||
+      sizeof(header) + toc_size > header.size) {
+    ESP_LOGE(TAG, "No valid bundle, flash it with `idf.py assets-flash`");
+    return -1;
+  }
+  const void *ptr;
+  if (esp_partition_mmap(part, 0, header.size, SPI_FLASH_MMAP_DATA, &ptr,
+                         &s_mmap) != ESP_OK) {
+    ESP_LOGE(TAG, "Unable to map %u bytes", header.size);
+    return -1;
+  }
+  s_base = static_cast<const uint8_t *>(ptr);
+  s_header = reinterpret_cast<const assets_header_t *>(s_base);
+  s_toc = reinterpret_cast<const assets_toc_entry_t *>(s_base + sizeof(header));
+  if (crc32(s_toc, toc_size) != header.toc_crc) {
+    ESP_LOGE(TAG, "TOC CRC mismatch");
+    assets_release();
+    return -1;
+  }
+  for (size_t i = 0; i < header.count; i++) {
+    const auto &entry = s_toc[i];
+    if (entry.name[ASSETS_NAME_LEN - 1] || entry.offset % ASSETS_ALIGN ||
+        entry.offset > header.size || entry.size > header.size - entry.offset) {
+      ESP_LOGE(TAG, "Malformed TOC entry %u", i);
+      assets_release();
+      return -1;
+    }
+  }
+  memset(s_verified, 0, sizeof(s_verified));
+  ESP_LOGI(TAG, "%u assets, %u bytes", header.count, header.size);
+  return 0;
+}
+
+void assets_release() {
+  if (s_base) {
+    spi_flash_munmap(s_mmap);
+    s_base = NULL;
+    s_header = NULL;
+    s_toc = NULL;
+  }
+}
+
+int assets_find(const char *name, asset_type_t type, asset_t *asset) {
+  if (s_base == NULL) {
+    return -1;
+  }
+  // binary search, the packer sorts entries by name
+  size_t lo = 0;
+  size_t hi = s_header->count;
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    const int cmp = strncmp(name, s_toc[mid].name, ASSETS_NAME_LEN);
+    if (cmp == 0) {
+      const auto &entry = s_toc[mid];
+      if (entry.type != type) {
+        ESP_LOGE(TAG, "%s: type %u, expected %u", name, entry.type, type);
+        return -1;
+      }
+      // lazy check, only assets in use are read through
+      const uint32_t bit = 1u << (mid % 32);
+      if (!(s_verified[mid / 32] & bit)) {
+        if (crc32(s_base + entry.offset, entry.size) != entry.crc) {
+          ESP_LOGE(TAG, "%s: CRC mismatch", name);
+          return -1;
+        }
+        s_verified[mid / 32] |= bit;
+      }
+      asset->data = s_base + entry.offset;
+      asset->size = entry.size;
+      return 0;
+    }
+    if (cmp < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  ESP_LOGE(TAG, "%s: not found", name);
+  return -1;
+}
+
+const void *assets_at(uint32_t offset) {
+  if (s_base == NULL || offset >= s_header->size) {
+    return NULL;
+  }
+  return s_base + offset;
+}
+
+void assets_dump() {
+  if (s_base == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < s_header->count; i++) {
+    const auto &entry = s_toc[i];
+    ESP_LOGI(TAG, "%-32s type=%u, offset=%u, size=%u", entry.name, entry.type,
+             entry.offset, entry.size);
+  }
+}
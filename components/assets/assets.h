@@ -0,0 +1,89 @@
+#ifndef _ASSETS_H_
+#define _ASSETS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/*! \brief Partition of the bundle written by tools/pack_assets.py. */
+#define ASSETS_PARTITION "assets"
+#define ASSETS_MAGIC     0x42414c4c // "LLAB"
+#define ASSETS_VERSION   1
+#define ASSETS_NAME_LEN  32
+/*! \brief Alignment of every asset in the bundle, models need 16. */
+#define ASSETS_ALIGN 16
+
+/*! \brief Asset type, checked on lookup. */
+enum asset_type_t {
+  /*! \brief TFLite flatbuffer. */
+  ASSET_MODEL = 1,
+  /*! \brief IMA-ADPCM WAV of a voice prompt, "<table>/<prompt>". */
+  ASSET_WAV = 2,
+  /*! \brief wav_prompt_t array of a prompt table, same order as the table,
+   * data offsets from the bundle start. */
+  ASSET_PROMPT_INDEX = 3,
+  /*! \brief XBM bitmap. */
+  ASSET_BITMAP = 4,
+  /*! \brief int8 reference MFCC frames of a prompt table, "<table>.mfcc",
+   * see main/eng_teacher/PronScore.h. */
+  ASSET_MFCC = 5,
+};
+
+/*! \brief Bundle header, little endian, followed by the TOC. */
+struct assets_header_t {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+  /*! \brief Bundle size, header included. */
+  uint32_t size;
+  /*! \brief CRC-32 of the TOC. */
+  uint32_t toc_crc;
+};
+
+/*! \brief TOC entry, entries are sorted by name. */
+struct assets_toc_entry_t {
+  /*! \brief Zero padded, zero terminated. */
+  char name[ASSETS_NAME_LEN];
+  uint16_t type;
+  uint16_t reserved;
+  /*! \brief Offset from the bundle start, ASSETS_ALIGN aligned. */
+  uint32_t offset;
+  uint32_t size;
+  /*! \brief CRC-32 of the asset, checked on first lookup. */
+  uint32_t crc;
+};
+
+/*! \brief Asset mapped from flash, valid until assets_release. */
+struct asset_t {
+  const void *data;
+  size_t size;
+};
+
+/*!
+ * \brief Map the bundle partition and check its header and TOC.
+ * \return 0 on success, -1 on error.
+ */
+int assets_init();
+/*!
+ * \brief Unmap the bundle.
+ */
+void assets_release();
+/*!
+ * \brief Look up asset by name.
+ * \param name Asset name.
+ * \param type Expected type.
+ * \param asset Found asset.
+ * \return 0 on success, -1 when missing, of other type or corrupted.
+ */
+int assets_find(const char *name, asset_type_t type, asset_t *asset);
+/*!
+ * \brief Get bundle data by offset, e.g. of a prompt index.
+ * \param offset Offset from the bundle start.
+ * \return Data or NULL past the bundle.
+ */
+const void *assets_at(uint32_t offset);
+/*!
+ * \brief Log TOC.
+ */
+void assets_dump();
+
+#endif // _ASSETS_H_
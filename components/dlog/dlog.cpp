@@ -0,0 +1,93 @@
+#if CONFIG_DLOG
+#include <atomic>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include "dlog.h"
+
+#define DLOG_RECORDS CONFIG_DLOG_RING_RECORDS
+static_assert((DLOG_RECORDS & (DLOG_RECORDS - 1)) == 0,
+              "DLOG_RING_RECORDS must be a power of two");
+
+// fmt, tag, stamp, meta, args
+#define DLOG_HEADER_WORDS 4
+
+/*! \brief Ring slot, seq tells whether it is free or holds a record. */
+struct dlog_slot_t {
+  std::atomic<uint32_t> seq;
+  uint32_t words[DLOG_HEADER_WORDS + DLOG_MAX_ARGS];
+};
+
+/*! \brief Bounded multi producer, single consumer ring without locks. */
+struct dlog_ring_t {
+  dlog_slot_t slots[DLOG_RECORDS];
+  std::atomic<uint32_t> head;
+  std::atomic<uint32_t> dropped;
+  uint32_t tail;
+
+  dlog_ring_t() : head(0), dropped(0), tail(0) {
+    for (uint32_t i = 0; i < DLOG_RECORDS; i++) {
+      slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+};
+
+static dlog_ring_t s_ring;
+
+void dlog_push(esp_log_level_t level, const char *tag, const char *format,
+               const uint32_t *args, size_t nargs) {
+  const uint32_t stamp = uint32_t(esp_timer_get_time());
+  uint32_t pos = s_ring.head.load(std::memory_order_relaxed);
+  dlog_slot_t *slot;
+  for (;;) {
+    slot = &s_ring.slots[pos % DLOG_RECORDS];
+    const int32_t diff =
+      int32_t(slot->seq.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (s_ring.head.compare_exchange_weak(pos, pos + 1,
+                                            std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // the consumer has not freed the slot yet
+      s_ring.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      pos = s_ring.head.load(std::memory_order_relaxed);
+    }
+  }
+  slot->words[0] = uint32_t(uintptr_t(format));
+  slot->words[1] = uint32_t(uintptr_t(tag));
+  slot->words[2] = stamp;
+  slot->words[3] = uint32_t(level) | nargs << 8 | xPortGetCoreID() << 16;
+  memcpy(&slot->words[DLOG_HEADER_WORDS], args, nargs * sizeof(uint32_t));
+  slot->seq.store(pos + 1, std::memory_order_release);
+}
+
+size_t dlog_drain(size_t max_records) {
+  size_t drained = 0;
+  for (; drained < max_records; drained++) {
+    const uint32_t pos = s_ring.tail;
+    dlog_slot_t *slot = &s_ring.slots[pos % DLOG_RECORDS];
+    if (slot->seq.load(std::memory_order_acquire) != pos + 1) {
+      // empty or the record is still being written
+      break;
+    }
+    const size_t words = DLOG_HEADER_WORDS + ((slot->words[3] >> 8) & 0xff);
+    char line[4 + (DLOG_HEADER_WORDS + DLOG_MAX_ARGS) * 9 + 1];
+    size_t len = snprintf(line, sizeof(line), "#D");
+    for (size_t i = 0; i < words; i++) {
+      len += snprintf(&line[len], sizeof(line) - len, " %x", slot->words[i]);
+    }
+    slot->seq.store(pos + DLOG_RECORDS, std::memory_order_release);
+    s_ring.tail = pos + 1;
+    puts(line);
+  }
+  return drained;
+}
+
+uint32_t dlog_dropped() {
+  return s_ring.dropped.load(std::memory_order_relaxed);
+}
+#endif
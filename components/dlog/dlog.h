@@ -0,0 +1,118 @@
+#ifndef _DLOG_H_
+#define _DLOG_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "esp_log.h"
+
+/*! \brief Max argument words per record, 64-bit values take two. */
+#define DLOG_MAX_ARGS 6
+
+#if CONFIG_DLOG
+/*!
+ * \brief Deferred logging for hot paths. A record keeps the format and tag
+ * addresses, a timestamp and raw argument words, tools/dlog_decode.py
+ * restores the text from the ELF. Format and %s arguments must be static
+ * strings, floats are stored as single precision. The dead printf keeps
+ * compile time format checks.
+ */
+#define DLOG_LEVEL(level, tag, format, ...)                                    \
+  do {                                                                         \
+    if (LOG_LOCAL_LEVEL >= level) {                                            \
+      if (0) {                                                                 \
+        printf(format, ##__VA_ARGS__);                                         \
+      }                                                                        \
+      dlog_write(level, tag, format, ##__VA_ARGS__);                           \
+    }                                                                          \
+  } while (0)
+
+/*!
+ * \brief Queue record, drops it when the ring is full.
+ * \param level Log level.
+ * \param tag Static tag string.
+ * \param format Static format string.
+ * \param args Argument words.
+ * \param nargs Number of argument words.
+ */
+void dlog_push(esp_log_level_t level, const char *tag, const char *format,
+               const uint32_t *args, size_t nargs);
+/*!
+ * \brief Emit queued records to the console as "#D" lines, consumer only.
+ * \param max_records Max number of records to emit.
+ * \return Number of emitted records.
+ */
+size_t dlog_drain(size_t max_records);
+/*!
+ * \brief Records dropped because the ring was full.
+ */
+uint32_t dlog_dropped();
+
+static inline void dlog_put(uint32_t *args, size_t &n, uint32_t word) {
+  if (n < DLOG_MAX_ARGS) {
+    args[n++] = word;
+  }
+}
+static inline void dlog_pack_arg(uint32_t *args, size_t &n, float v) {
+  uint32_t word;
+  memcpy(&word, &v, sizeof(word));
+  dlog_put(args, n, word);
+}
+static inline void dlog_pack_arg(uint32_t *args, size_t &n, double v) {
+  dlog_pack_arg(args, n, float(v));
+}
+static inline void dlog_pack_arg(uint32_t *args, size_t &n,
+                                 unsigned long long v) {
+  dlog_put(args, n, uint32_t(v));
+  dlog_put(args, n, uint32_t(v >> 32));
+}
+static inline void dlog_pack_arg(uint32_t *args, size_t &n, long long v) {
+  dlog_pack_arg(args, n, (unsigned long long)v);
+}
+template <typename T>
+static inline void dlog_pack_arg(uint32_t *args, size_t &n, T *v) {
+  dlog_put(args, n, uint32_t(uintptr_t(v)));
+}
+template <typename T>
+static inline void dlog_pack_arg(uint32_t *args, size_t &n, T v) {
+  dlog_put(args, n, uint32_t(v));
+}
+
+static inline void dlog_pack(uint32_t *args, size_t &n) {}
+template <typename T, typename... Rest>
+static inline void dlog_pack(uint32_t *args, size_t &n, T v, Rest... rest) {
+  dlog_pack_arg(args, n, v);
+  dlog_pack(args, n, rest...);
+}
+
+template <typename... Args>
+static inline void dlog_write(esp_log_level_t level, const char *tag,
+                              const char *format, Args... args) {
+  static_assert(sizeof...(Args) <= DLOG_MAX_ARGS, "too many dlog arguments");
+  uint32_t words[DLOG_MAX_ARGS];
+  size_t n = 0;
+  dlog_pack(words, n, args...);
+  dlog_push(level, tag, format, words, n);
+}
+#else
+#define DLOG_LEVEL(level, tag, format, ...)                                    \
+  ESP_LOG_LEVEL_LOCAL(level, tag, format, ##__VA_ARGS__)
+
+static inline size_t dlog_drain(size_t max_records) { return 0; }
+static inline uint32_t dlog_dropped() { return 0; }
+#endif
+
+#define DLOGE(tag, format, ...)                                                \
+  DLOG_LEVEL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define DLOGW(tag, format, ...)                                                \
+  DLOG_LEVEL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define DLOGI(tag, format, ...)                                                \
+  DLOG_LEVEL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define DLOGD(tag, format, ...)                                                \
+  DLOG_LEVEL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define DLOGV(tag, format, ...)                                                \
+  DLOG_LEVEL(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#endif // _DLOG_H_
@@ -0,0 +1,314 @@
+#if CONFIG_ALLOC_TRACK
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "esp_cpu.h"
+#include "esp_debug_helpers.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "alloc_track.h"
+
+static const char *TAG = "alloc_track";
+
+#define TRACK_TASKS_NUM      16
+#define TRACK_SITES_NUM      32
+#define TRACK_TOP_SITES_NUM  8
+#define TRACK_VIOLATIONS_NUM 8
+#define TRACK_BT_DEPTH       8
+
+// malloc family is wrapped by the linker, see CMakeLists.txt
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+}
+
+struct task_counters_t {
+  TaskHandle_t task;
+  char name[configMAX_TASK_NAME_LEN];
+  const char *zone;
+  uint32_t allocs;
+  uint32_t frees;
+  size_t bytes;
+  uint32_t violations;
+};
+
+struct call_site_t {
+  uint32_t pc;
+  uint32_t count;
+  size_t bytes;
+};
+
+struct violation_t {
+  task_counters_t *owner;
+  const char *zone;
+  size_t size;
+  bool reported;
+  size_t depth;
+  uint32_t pc[TRACK_BT_DEPTH];
+  uint32_t sp[TRACK_BT_DEPTH];
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static task_counters_t s_tasks[TRACK_TASKS_NUM];
+static call_site_t s_sites[TRACK_SITES_NUM];
+static violation_t s_violations[TRACK_VIOLATIONS_NUM];
+static uint32_t s_violations_num = 0;
+static uint32_t s_untracked = 0;
+
+static inline uint32_t caller_pc(void *ret_addr) {
+  return esp_cpu_process_stack_pc(uint32_t(ret_addr));
+}
+
+static task_counters_t *find_task(TaskHandle_t task) {
+  for (auto &tc : s_tasks) {
+    if (tc.task == task && tc.name[0]) {
+      return &tc;
+    }
+  }
+  for (auto &tc : s_tasks) {
+    if (!tc.name[0]) {
+      // handles of static tasks are reused, the slot keeps the first name
+      tc.task = task;
+      strncpy(tc.name, task ? pcTaskGetName(task) : "-",
+              sizeof(tc.name) - 1);
+      return &tc;
+    }
+  }
+  return NULL;
+}
+
+static void add_site(uint32_t pc, size_t size) {
+  call_site_t *free_site = NULL;
+  for (auto &site : s_sites) {
+    if (site.pc == pc) {
+      site.count++;
+      site.bytes += size;
+      return;
+    }
+    if (!site.pc && !free_site) {
+      free_site = &site;
+    }
+  }
+  if (free_site) {
+    *free_site = {pc, 1, size};
+  } else {
+    s_untracked++;
+  }
+}
+
+static void capture_backtrace(violation_t *v) {
+  esp_backtrace_frame_t frame;
+  esp_backtrace_get_start(&frame.pc, &frame.sp, &frame.next_pc);
+  v->depth = 0;
+  // skip this function, track_alloc and the wrapper
+  for (size_t skip = 0; skip < 3; skip++) {
+    if (!esp_backtrace_get_next_frame(&frame)) {
+      return;
+    }
+  }
+  do {
+    v->pc[v->depth] = esp_cpu_process_stack_pc(frame.pc);
+    v->sp[v->depth] = frame.sp;
+    v->depth++;
+  } while (v->depth < TRACK_BT_DEPTH && frame.next_pc &&
+           esp_backtrace_get_next_frame(&frame));
+}
+
+static void track_alloc(size_t size, uint32_t pc) {
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  const char *zone = NULL;
+
+  portENTER_CRITICAL_SAFE(&s_lock);
+  task_counters_t *tc = find_task(task);
+  if (tc) {
+    tc->allocs++;
+    tc->bytes += size;
+    zone = tc->zone;
+    if (zone) {
+      tc->violations++;
+    }
+  }
+  add_site(pc, size);
+  portEXIT_CRITICAL_SAFE(&s_lock);
+
+  if (!zone) {
+    return;
+  }
+  violation_t v = {.owner = tc, .zone = zone, .size = size};
+  capture_backtrace(&v);
+  portENTER_CRITICAL_SAFE(&s_lock);
+  s_violations[s_violations_num++ % TRACK_VIOLATIONS_NUM] = v;
+  portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+static void track_free(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  portENTER_CRITICAL_SAFE(&s_lock);
+  task_counters_t *tc = find_task(task);
+  if (tc) {
+    tc->frees++;
+  }
+  portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+extern "C" void *__wrap_malloc(size_t size) {
+  track_alloc(size, caller_pc(__builtin_return_address(0)));
+  return __real_malloc(size);
+}
+
+extern "C" void *__wrap_calloc(size_t n, size_t size) {
+  track_alloc(n * size, caller_pc(__builtin_return_address(0)));
+  return __real_calloc(n, size);
+}
+
+extern "C" void *__wrap_realloc(void *ptr, size_t size) {
+  if (size) {
+    track_alloc(size, caller_pc(__builtin_return_address(0)));
+  } else {
+    track_free(ptr);
+  }
+  return __real_realloc(ptr, size);
+}
+
+extern "C" void __wrap_free(void *ptr) {
+  track_free(ptr);
+  __real_free(ptr);
+}
+
+// Replace the library operators so that call sites point at the caller of
+// new rather than at libstdc++.
+static void *tracked_new(size_t size, uint32_t pc, bool abort_on_fail) {
+  track_alloc(size, pc);
+  void *ptr = __real_malloc(size ? size : 1);
+  if (!ptr && abort_on_fail) {
+    abort();
+  }
+  return ptr;
+}
+
+void *operator new(size_t size) {
+  return tracked_new(size, caller_pc(__builtin_return_address(0)), true);
+}
+void *operator new[](size_t size) {
+  return tracked_new(size, caller_pc(__builtin_return_address(0)), true);
+}
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return tracked_new(size, caller_pc(__builtin_return_address(0)), false);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return tracked_new(size, caller_pc(__builtin_return_address(0)), false);
+}
+void operator delete(void *ptr) noexcept { __wrap_free(ptr); }
+void operator delete[](void *ptr) noexcept { __wrap_free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { __wrap_free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { __wrap_free(ptr); }
+
+static void set_zone(const char *name) {
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  portENTER_CRITICAL(&s_lock);
+  task_counters_t *tc = find_task(task);
+  if (tc) {
+    tc->zone = name;
+  }
+  portEXIT_CRITICAL(&s_lock);
+}
+
+void alloc_zone_enter(const char *name) { set_zone(name); }
+
+void alloc_zone_exit() { set_zone(NULL); }
+
+static void log_violation(const violation_t &v) {
+  char bt[TRACK_BT_DEPTH * 22 + 1] = {0};
+  size_t len = 0;
+  for (size_t i = 0; i < v.depth && len < sizeof(bt); i++) {
+    len += snprintf(&bt[len], sizeof(bt) - len, " 0x%08x:0x%08x", v.pc[i],
+                    v.sp[i]);
+  }
+  ESP_LOGW(TAG, "%s: %u bytes allocated in no-alloc zone %s", v.owner->name,
+           v.size, v.zone);
+  // same format as the panic handler, idf.py monitor decodes it
+  ESP_LOGW(TAG, "Backtrace:%s", bt);
+}
+
+/*!
+ * \brief Log pending violations, of the given task or all if NULL.
+ */
+static void report_violations(task_counters_t *owner) {
+  for (;;) {
+    violation_t v;
+    bool found = false;
+    portENTER_CRITICAL(&s_lock);
+    for (auto &pending : s_violations) {
+      if (pending.owner && !pending.reported &&
+          (!owner || pending.owner == owner)) {
+        pending.reported = true;
+        v = pending;
+        found = true;
+        break;
+      }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!found) {
+      return;
+    }
+    log_violation(v);
+  }
+}
+
+void alloc_zone_check() {
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  portENTER_CRITICAL(&s_lock);
+  task_counters_t *tc = find_task(task);
+  portEXIT_CRITICAL(&s_lock);
+  if (tc && tc->violations) {
+    report_violations(tc);
+  }
+}
+
+void alloc_track_dump() {
+  task_counters_t tasks[TRACK_TASKS_NUM];
+  call_site_t sites[TRACK_SITES_NUM];
+  portENTER_CRITICAL(&s_lock);
+  memcpy(tasks, s_tasks, sizeof(tasks));
+  memcpy(sites, s_sites, sizeof(sites));
+  const uint32_t violations_num = s_violations_num;
+  const uint32_t untracked = s_untracked;
+  portEXIT_CRITICAL(&s_lock);
+
+  ESP_LOGI(TAG, "%-16s %8s %8s %8s %6s", "task", "allocs", "frees", "bytes",
+           "zone!");
+  for (const auto &tc : tasks) {
+    if (tc.name[0]) {
+      ESP_LOGI(TAG, "%-16s %8u %8u %8u %6u", tc.name, tc.allocs, tc.frees,
+               tc.bytes, tc.violations);
+    }
+  }
+
+  // top call sites by count, the table is small so selection sort is fine
+  for (size_t n = 0; n < TRACK_TOP_SITES_NUM; n++) {
+    call_site_t *top = NULL;
+    for (auto &site : sites) {
+      if (site.pc && (!top || site.count > top->count)) {
+        top = &site;
+      }
+    }
+    if (!top) {
+      break;
+    }
+    ESP_LOGI(TAG, "site 0x%08x: count=%u, bytes=%u", top->pc, top->count,
+             top->bytes);
+    top->pc = 0;
+  }
+  ESP_LOGI(TAG, "violations=%u, untracked sites=%u", violations_num,
+           untracked);
+  report_violations(NULL);
+}
+#endif
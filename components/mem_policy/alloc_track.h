@@ -0,0 +1,31 @@
+#ifndef _ALLOC_TRACK_H_
+#define _ALLOC_TRACK_H_
+
+#if CONFIG_ALLOC_TRACK
+/*!
+ * \brief Mark the calling task as being in a steady-state loop, any heap
+ * allocation from it is a violation.
+ * \param name Zone name.
+ */
+void alloc_zone_enter(const char *name);
+/*!
+ * \brief Leave no-alloc zone of the calling task.
+ */
+void alloc_zone_exit();
+/*!
+ * \brief Log violations of the calling task with backtraces, call outside
+ * of allocation paths, e.g. once per loop iteration.
+ */
+void alloc_zone_check();
+/*!
+ * \brief Log per task counters, top call sites and all pending violations.
+ */
+void alloc_track_dump();
+#else
+static inline void alloc_zone_enter(const char *name) {}
+static inline void alloc_zone_exit() {}
+static inline void alloc_zone_check() {}
+static inline void alloc_track_dump() {}
+#endif
+
+#endif // _ALLOC_TRACK_H_
@@ -0,0 +1,84 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "soc/soc_memory_layout.h"
+#include "freertos/FreeRTOS.h"
+
+#include "mem_policy.h"
+
+static const char *TAG = "mem_policy";
+
+#define MEM_ALIGNMENT 16
+
+struct mem_class_stats_t {
+  size_t internal_bytes;
+  size_t psram_bytes;
+  size_t failures;
+};
+
+static const char *s_class_names[MEM_CLASSES_NUM] = {"hot", "cold"};
+static const uint32_t s_class_caps[MEM_CLASSES_NUM] = {
+  MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+  MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static mem_class_stats_t s_stats[MEM_CLASSES_NUM];
+
+void *mem_alloc(size_t size, mem_class_t cls) {
+  void *ptr = heap_caps_aligned_alloc(MEM_ALIGNMENT, size, s_class_caps[cls]);
+  if (!ptr && cls == MEM_COLD) {
+    // no PSRAM or it is full, cold data still has to live somewhere
+    ptr = heap_caps_aligned_alloc(MEM_ALIGNMENT, size,
+                                  s_class_caps[MEM_HOT]);
+  }
+
+  portENTER_CRITICAL(&s_lock);
+  auto &stats = s_stats[cls];
+  if (!ptr) {
+    stats.failures++;
+  } else if (esp_ptr_external_ram(ptr)) {
+    stats.psram_bytes += size;
+  } else {
+    stats.internal_bytes += size;
+  }
+  portEXIT_CRITICAL(&s_lock);
+
+  if (!ptr) {
+    ESP_LOGE(TAG, "unable to allocate %u bytes of %s memory", size,
+             s_class_names[cls]);
+  }
+  return ptr;
+}
+
+void *mem_alloc_or_abort(size_t size, mem_class_t cls) {
+  void *ptr = mem_alloc(size, cls);
+  if (!ptr) {
+    abort();
+  }
+  return ptr;
+}
+
+void mem_free(void *ptr) { heap_caps_free(ptr); }
+
+bool mem_is_internal(const void *ptr) { return esp_ptr_internal(ptr); }
+
+void mem_policy_dump() {
+  mem_class_stats_t stats[MEM_CLASSES_NUM];
+  portENTER_CRITICAL(&s_lock);
+  memcpy(stats, s_stats, sizeof(stats));
+  portEXIT_CRITICAL(&s_lock);
+
+  for (size_t i = 0; i < MEM_CLASSES_NUM; i++) {
+    ESP_LOGI(TAG, "%-8s allocated: internal=%u, psram=%u, failures=%u",
+             s_class_names[i], stats[i].internal_bytes, stats[i].psram_bytes,
+             stats[i].failures);
+  }
+  ESP_LOGI(TAG, "free: internal=%u (largest %u), dma=%u, psram=%u",
+           heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+           heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+           heap_caps_get_free_size(MALLOC_CAP_DMA),
+           heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+}
@@ -0,0 +1,69 @@
+#ifndef _MEM_POLICY_H_
+#define _MEM_POLICY_H_
+
+#include <cstddef>
+#include <vector>
+
+/*! \brief Placement class of a buffer. */
+enum mem_class_t {
+  /*! \brief Internal SRAM: tensor arena, FFT and per frame buffers. */
+  MEM_HOT = 0,
+  /*! \brief PSRAM when available, else internal SRAM: bulk or rarely used
+   * data. */
+  MEM_COLD,
+  MEM_CLASSES_NUM,
+};
+
+/*!
+ * \brief Allocate 16 bytes aligned buffer by placement class.
+ * \param size Buffer size.
+ * \param cls Placement class.
+ * \return Buffer or NULL.
+ */
+void *mem_alloc(size_t size, mem_class_t cls);
+/*!
+ * \brief Allocate like mem_alloc, abort when out of memory.
+ */
+void *mem_alloc_or_abort(size_t size, mem_class_t cls);
+/*!
+ * \brief Free buffer from mem_alloc.
+ * \param ptr Buffer.
+ */
+void mem_free(void *ptr);
+/*!
+ * \brief Check if buffer is in internal SRAM.
+ * \param ptr Buffer.
+ * \return Buffer is internal.
+ */
+bool mem_is_internal(const void *ptr);
+/*!
+ * \brief Log bytes allocated per class, where they landed and free heap.
+ */
+void mem_policy_dump();
+
+/*! \brief STL allocator placing elements by class. */
+template <typename T, mem_class_t CLS> struct mem_allocator {
+  typedef T value_type;
+
+  mem_allocator() = default;
+  template <typename U> mem_allocator(const mem_allocator<U, CLS> &) {}
+  template <typename U> struct rebind {
+    typedef mem_allocator<U, CLS> other;
+  };
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(mem_alloc_or_abort(n * sizeof(T), CLS));
+  }
+  void deallocate(T *ptr, size_t) { mem_free(ptr); }
+  template <typename U> bool operator==(const mem_allocator<U, CLS> &) const {
+    return true;
+  }
+  template <typename U> bool operator!=(const mem_allocator<U, CLS> &) const {
+    return false;
+  }
+};
+
+template <typename T>
+using hot_vector = std::vector<T, mem_allocator<T, MEM_HOT>>;
+
+#endif // _MEM_POLICY_H_
@@ -80,4 +80,134 @@ public:
   }
 };
 
+/*!
+ * \brief Polyphase FIR decimator by 2 with Q15 coefficients.
+ * y[m] = sum(h[2k] * x[2m+1-2k]) + sum(h[2k+1] * x[2m-2k]), the odd input
+ * samples go through phase 0 and the even ones through phase 1.
+ */
+template <size_t TAPS> struct polyphase_decimator_2 {
+  static_assert(TAPS % 2 == 0, "TAPS must be even");
+
+private:
+  static constexpr size_t PHASE_TAPS = TAPS / 2;
+  // h[0], h[2], ...
+  int16_t phase0_[PHASE_TAPS];
+  // h[1], h[3], ...
+  int16_t phase1_[PHASE_TAPS];
+  // Histories of x[2m+1] and x[2m], stored twice so the last PHASE_TAPS
+  // samples are contiguous from pos_ on, newest first.
+  int16_t x0_[2 * PHASE_TAPS];
+  int16_t x1_[2 * PHASE_TAPS];
+  size_t pos_;
+
+public:
+  polyphase_decimator_2(const int16_t *coeffs) {
+    for (size_t k = 0; k < PHASE_TAPS; k++) {
+      phase0_[k] = coeffs[2 * k];
+      phase1_[k] = coeffs[2 * k + 1];
+    }
+    reset();
+  }
+
+  /*!
+   * \brief Filter and decimate buffer.
+   * \param dst Output buffer, len / 2 samples.
+   * \param src Input buffer.
+   * \param len Input len, must be even.
+   * \return Output len.
+   */
+  size_t proc_buffer(int16_t *dst, const int16_t *src, size_t len) {
+    for (size_t n = 0; n + 1 < len; n += 2) {
+      pos_ = (pos_ == 0 ? PHASE_TAPS : pos_) - 1;
+      x0_[pos_] = x0_[pos_ + PHASE_TAPS] = src[n + 1];
+      x1_[pos_] = x1_[pos_ + PHASE_TAPS] = src[n];
+      const int16_t *x0 = &x0_[pos_];
+      const int16_t *x1 = &x1_[pos_];
+
+      // sum(|h|) < 2^16, so the accumulator can't overflow int32
+      int32_t acc = 1 << 14;
+      for (size_t k = 0; k < PHASE_TAPS; k++) {
+        acc += int32_t(phase0_[k]) * x0[k] + int32_t(phase1_[k]) * x1[k];
+      }
+      acc >>= 15;
+      if (acc > INT16_MAX) {
+        acc = INT16_MAX;
+      } else if (acc < INT16_MIN) {
+        acc = INT16_MIN;
+      }
+      dst[n / 2] = acc;
+    }
+    return len / 2;
+  }
+  void reset() {
+    memset(x0_, 0, sizeof(x0_));
+    memset(x1_, 0, sizeof(x1_));
+    pos_ = 0;
+  }
+};
+
+/*! \brief Frame energy gate with adaptive noise floor and hangover. */
+struct energy_gate {
+private:
+  uint32_t floor_;
+  uint32_t open_ratio_;
+  uint32_t zcr_ratio_;
+  uint32_t zcr_q8_;
+  size_t hangover_frames_;
+  size_t hangover_;
+
+public:
+  /*!
+   * \param open_ratio Energy to noise floor ratio opening the gate.
+   * \param zcr_ratio Lower ratio opening the gate on high ZCR frames.
+   * \param zcr_q8 ZCR threshold (crossings per sample, Q8).
+   * \param hangover_frames Frames to keep the gate open.
+   */
+  energy_gate(uint32_t open_ratio, uint32_t zcr_ratio, uint32_t zcr_q8,
+              size_t hangover_frames)
+    : open_ratio_(open_ratio), zcr_ratio_(zcr_ratio), zcr_q8_(zcr_q8),
+      hangover_frames_(hangover_frames) {
+    reset();
+  }
+
+  /*!
+   * \brief Process frame statistics.
+   * \param energy Frame mean square.
+   * \param zcr_q8 Frame zero crossing rate, Q8.
+   * \return Gate is open.
+   */
+  bool proc_frame(uint32_t energy, uint32_t zcr_q8) {
+    if (floor_ == 0) {
+      floor_ = energy > 1 ? energy : 1;
+    }
+    const uint64_t floor = floor_;
+    const bool loud = energy > floor * open_ratio_;
+    // Unvoiced consonants are quiet but noisy.
+    const bool fricative = zcr_q8 > zcr_q8_ && energy > floor * zcr_ratio_;
+    if (loud || fricative) {
+      hangover_ = hangover_frames_;
+    } else if (hangover_) {
+      hangover_--;
+    }
+
+    // Fast fall, slow rise. Keep rising while open so a louder room can't
+    // latch the gate.
+    if (energy < floor_) {
+      floor_ -= (floor_ - energy) >> 2;
+    } else if (energy > floor_) {
+      floor_ += ((energy - floor_) >> (hangover_ ? 10 : 7)) + 1;
+    }
+    if (floor_ == 0) {
+      floor_ = 1;
+    }
+    return hangover_ > 0;
+  }
+  bool is_open() const { return hangover_ > 0; }
+  uint32_t noise_floor() const { return floor_; }
+  void reset() {
+    floor_ = 0;
+    hangover_ = 0;
+  }
+};
+
 #endif // _MIC_PROC_H_
@@ -27,39 +27,48 @@
 
 AudioPreprocessor::AudioPreprocessor(int numMfccFeatures, int frameLen,
                                      int numFbankBins, int melLowF,
-                                     int melHighF)
+                                     int melHighF, int sampleRate)
   : numMfccFeatures(numMfccFeatures), frameLen(frameLen),
-    numFbankBins(numFbankBins) {
+    numFbankBins(numFbankBins), sampleRate(sampleRate) {
   // Round-up to nearest power of 2.
   frameLenPadded = pow(2, ceil((log(frameLen) / log(2))));
 
-  frame = std::vector<float>(frameLenPadded, 0.0);
-  buffer = std::vector<float>(frameLenPadded, 0.0);
-  melEnergies = std::vector<float>(numFbankBins, 0.0);
+  frame.assign(frameLenPadded, 0.0);
+  buffer.assign(frameLenPadded, 0.0);
+  melEnergies.assign(numFbankBins, 0.0);
 
-  // Create window function.
-  windowFunc = std::vector<float>(frameLen, 0.0);
+  // Create window function. Decimated frames hold fewer samples per window,
+  // scale them to keep spectral magnitudes on the full-rate scale.
+  const float windowGain = static_cast<float>(SAMP_FREQ) / sampleRate;
+  windowFunc.assign(frameLen, 0.0);
   for (int i = 0; i < frameLen; i++)
     windowFunc[i] =
-      0.5 - 0.5 * riscv_cos_f32(M_2PI * (static_cast<float>(i)) / (frameLen));
+      windowGain *
+      (0.5 - 0.5 * riscv_cos_f32(M_2PI * (static_cast<float>(i)) / (frameLen)));
 
   // Create mel filterbank.
-  fbankFilterFirst = std::vector<int32_t>(numFbankBins, 0);
-  fbankFilterLast = std::vector<int32_t>(numFbankBins, 0);
+  fbankFilterFirst.assign(numFbankBins, 0);
+  fbankFilterLast.assign(numFbankBins, 0);
   melFbank = CreateMelFbank(melLowF, melHighF);
 
   // Create DCT matrix.
   dctMatrix = CreateDctMatrix(numFbankBins, numMfccFeatures);
+  dctRowSums.assign(numMfccFeatures, 0.0);
+  for (int i = 0; i < numMfccFeatures; i++) {
+    for (int j = 0; j < numFbankBins; j++) {
+      dctRowSums[i] += dctMatrix[i * numFbankBins + j];
+    }
+  }
 
   // Initialize FFT.
   riscv_rfft_fast_init_f32(&fft, frameLenPadded);
 }
 
-std::vector<float>
+hot_vector<float>
 AudioPreprocessor::CreateDctMatrix(int32_t inputLength,
                                    int32_t coefficientCount) {
   int32_t k, n;
-  std::vector<float> M(inputLength * coefficientCount);
+  hot_vector<float> M(inputLength * coefficientCount);
   float normalizer;
   normalizer = sqrt(2.0 / static_cast<float>(inputLength));
   for (k = 0; k < coefficientCount; k++) {
@@ -72,18 +81,18 @@ AudioPreprocessor::CreateDctMatrix(int32_t inputLength,
   return M;
 }
 
-std::vector<std::vector<float>>
+hot_vector<hot_vector<float>>
 AudioPreprocessor::CreateMelFbank(int melLowF, int melHighF) {
   int32_t bin, i;
 
   int32_t numFftBins = frameLenPadded / 2;
-  float fftBinWidth = (static_cast<float>(SAMP_FREQ)) / frameLenPadded;
+  float fftBinWidth = (static_cast<float>(sampleRate)) / frameLenPadded;
   float melLowFreq = MelScale(melLowF);
   float melHighFreq = MelScale(melHighF);
   float melFreqDelta = (melHighFreq - melLowFreq) / (numFbankBins + 1);
 
   std::vector<float> thisBin(numFftBins);
-  std::vector<std::vector<float>> melFbank(numFbankBins);
+  hot_vector<hot_vector<float>> melFbank(numFbankBins);
 
   for (bin = 0; bin < numFbankBins; bin++) {
     float leftMel = melLowFreq + bin * melFreqDelta;
@@ -193,3 +202,15 @@ void AudioPreprocessor::MfccCompute(const int16_t *audioData, float *outData,
     outData[i] = sum;
   }
 }
+
+void AudioPreprocessor::MfccNormalize(float *mfccData, size_t frames,
+                                      size_t max_abs) {
+  // Dividing input by max_abs shifts every log mel energy by -log(max_abs),
+  // so frames computed with max_abs = 1 can be normalized afterwards.
+  const float logScale = logf(max_abs > 0 ? max_abs : 1);
+  for (size_t f = 0; f < frames; f++) {
+    for (int32_t i = 0; i < numMfccFeatures; i++) {
+      mfccData[f * numMfccFeatures + i] -= logScale * dctRowSums[i];
+    }
+  }
+}
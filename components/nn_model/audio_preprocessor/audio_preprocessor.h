@@ -26,6 +26,7 @@ extern "C" {
 
 #include "dsp/fast_math_functions.h"
 #include "dsp/transform_functions.h"
+#include "mem_policy.h"
 #include <vector>
 
 #define SAMP_FREQ CONFIG_MIC_SAMPLE_RATE
@@ -41,18 +42,21 @@ private:
   int frameLen;
   int frameLenPadded;
   int numFbankBins;
-  std::vector<float> frame;
-  std::vector<float> buffer;
-  std::vector<float> melEnergies;
-  std::vector<float> windowFunc;
-  std::vector<int32_t> fbankFilterFirst;
-  std::vector<int32_t> fbankFilterLast;
-  std::vector<std::vector<float>> melFbank;
-  std::vector<float> dctMatrix;
+  int sampleRate;
+  // Touched on every frame, kept in internal SRAM.
+  hot_vector<float> frame;
+  hot_vector<float> buffer;
+  hot_vector<float> melEnergies;
+  hot_vector<float> windowFunc;
+  hot_vector<int32_t> fbankFilterFirst;
+  hot_vector<int32_t> fbankFilterLast;
+  hot_vector<hot_vector<float>> melFbank;
+  hot_vector<float> dctMatrix;
+  hot_vector<float> dctRowSums;
   riscv_rfft_fast_instance_f32 fft;
-  static std::vector<float> CreateDctMatrix(int32_t inputLength,
-                                            int32_t coefficientCount);
-  std::vector<std::vector<float>> CreateMelFbank(int melLowF, int melHighF);
+  static hot_vector<float> CreateDctMatrix(int32_t inputLength,
+                                           int32_t coefficientCount);
+  hot_vector<hot_vector<float>> CreateMelFbank(int melLowF, int melHighF);
 
   static inline float InverseMelScale(float melFreq) {
     return 700.0f * (expf(melFreq / 1127.0f) - 1.0f);
@@ -64,11 +68,12 @@ private:
 
 public:
   AudioPreprocessor(int numMfccFeatures, int frameLen, int numFbankBins,
-                    int melLowF, int melHighF);
+                    int melLowF, int melHighF, int sampleRate = SAMP_FREQ);
   ~AudioPreprocessor() = default;
 
   void MfccCompute(const int16_t *data, float *mfccOut, size_t max_abs);
   void LogMelCompute(const int16_t *data, float *mfccOut, size_t max_abs);
+  void MfccNormalize(float *mfccData, size_t frames, size_t max_abs);
 };
 
 #endif
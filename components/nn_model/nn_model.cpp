@@ -3,6 +3,9 @@
 
 #include "string.h"
 
+#include <algorithm>
+
+#include "dlog.h"
 #include "nn_model.h"
 #include "tensor_arena.h"
 #include "tflite_op_resolver.h"
@@ -10,9 +13,16 @@
 #include "tensorflow/lite/micro/micro_interpreter.h"
 #include "tensorflow/lite/schema/schema_generated.h"
 
+// growth of the kept arena region when the used size does not fit
+#define NN_ARENA_STEP 1024
+
 struct __nn_model_t {
   tflite::MicroInterpreter *interpreter;
+  /*! \brief Region of the shared tensor arena kept by the interpreter. */
+  uint8_t *arena;
   nn_model_config_t cfg;
+  /*! \brief Scores, allocated once to keep inference off the heap. */
+  float *out_buffer;
 };
 
 typedef __nn_model_t *__nn_model_handle_t;
@@ -54,6 +64,22 @@ static size_t argmax(float *array, size_t len) {
   return idx;
 }
 
+/*!
+ * \brief Interpreter with tensors allocated in arena.
+ * \return nullptr when the model does not fit.
+ */
+static tflite::MicroInterpreter *new_interpreter(const tflite::Model *model,
+                                                 uint8_t *arena,
+                                                 size_t arena_size) {
+  tflite::MicroInterpreter *interpreter = new tflite::MicroInterpreter(
+    model, TFLiteOpResolver::getInstance(), arena, arena_size);
+  if (interpreter->AllocateTensors() != kTfLiteOk) {
+    delete interpreter;
+    return nullptr;
+  }
+  return interpreter;
+}
+
 int nn_model_init(nn_model_handle_t *model_handle, nn_model_config_t cfg) {
   __nn_model_handle_t __nn_model_handle =
     static_cast<__nn_model_handle_t>(malloc(sizeof(__nn_model_t)));
@@ -72,26 +98,49 @@ int nn_model_init(nn_model_handle_t *model_handle, nn_model_config_t cfg) {
     return -1;
   }
 
-  uint8_t *tensor_arena = TensorArena::getBuffer();
+  __nn_model_handle->out_buffer =
+    static_cast<float *>(mem_alloc(cfg.labels_num * sizeof(float), MEM_HOT));
+  if (!__nn_model_handle->out_buffer) {
+    ESP_LOGE(__FUNCTION__, "unable to allocate out buffer");
+    free(__nn_model_handle);
+    return -1;
+  }
+
+  size_t free_size = 0;
+  uint8_t *tensor_arena = TensorArena::getBuffer(&free_size);
   if (!tensor_arena) {
     ESP_LOGE(__FUNCTION__, "unable to get tensor arena");
+    mem_free(__nn_model_handle->out_buffer);
     free(__nn_model_handle);
     return -1;
   }
-  // Build an interpreter to run the model with.
-  __nn_model_handle->interpreter =
-    new tflite::MicroInterpreter(model, TFLiteOpResolver::getInstance(),
-                                 tensor_arena, TensorArena::getSize());
-
-  // Allocate memory from the tensor_arena for the model's tensors.
-  TfLiteStatus allocate_status =
-    __nn_model_handle->interpreter->AllocateTensors();
-  if (allocate_status != kTfLiteOk) {
+  // Measure the model in all the free arena, then build the interpreter again
+  // in a region of the used size. Persistent data goes to the end of the
+  // region, so the region handed to TFLM must be the one kept.
+  tflite::MicroInterpreter *interpreter =
+    new_interpreter(model, tensor_arena, free_size);
+  size_t size = free_size;
+  if (interpreter) {
+    size = TensorArena::align(interpreter->arena_used_bytes());
+    delete interpreter;
+    // planning scratch may need more than the final layout
+    while (!(interpreter = new_interpreter(model, tensor_arena, size)) &&
+           size < free_size) {
+      size = std::min(size + NN_ARENA_STEP, free_size);
+    }
+  }
+  if (!interpreter) {
     ESP_LOGE(__FUNCTION__, "AllocateTensors() failed");
+    TensorArena::cancelBuffer();
+    mem_free(__nn_model_handle->out_buffer);
     free(__nn_model_handle);
     return -1;
   }
+  TensorArena::commitBuffer(tensor_arena, size);
+  DLOGD(__FUNCTION__, "arena %u of %u bytes", size, free_size);
 
+  __nn_model_handle->interpreter = interpreter;
+  __nn_model_handle->arena = tensor_arena;
   *model_handle = __nn_model_handle;
   memcpy(&__nn_model_handle->cfg, &cfg, sizeof(nn_model_config_t));
   return 0;
@@ -99,10 +148,11 @@ int nn_model_init(nn_model_handle_t *model_handle, nn_model_config_t cfg) {
 
 int nn_model_release(nn_model_handle_t model_handle) {
   if (model_handle) {
-    TensorArena::releaseBuffer();
     __nn_model_handle_t __nn_model_handle =
       static_cast<__nn_model_handle_t>(model_handle);
     delete __nn_model_handle->interpreter;
+    TensorArena::releaseBuffer(__nn_model_handle->arena);
+    mem_free(__nn_model_handle->out_buffer);
     free(__nn_model_handle);
   }
   return 0;
@@ -127,6 +177,19 @@ int nn_model_get_label(nn_model_handle_t model_handle, int category,
   return 0;
 }
 
+static int invoke(__nn_model_handle_t __nn_model_handle,
+                  const float *input_data, size_t len) {
+  set_input(input_data, __nn_model_handle->interpreter->input(0), len,
+            __nn_model_handle->cfg.is_quantized);
+
+  TfLiteStatus invoke_status = __nn_model_handle->interpreter->Invoke();
+  if (invoke_status != kTfLiteOk) {
+    ESP_LOGE(__FUNCTION__, "Invoke failed");
+    return -1;
+  }
+  return 0;
+}
+
 int nn_model_inference(nn_model_handle_t model_handle, const float *input_data,
                        size_t len, int *category) {
   if (!model_handle) {
@@ -138,33 +201,132 @@ int nn_model_inference(nn_model_handle_t model_handle, const float *input_data,
   nn_model_config_t &cfg = __nn_model_handle->cfg;
 
   const int64_t t1 = esp_timer_get_time();
-  set_input(input_data, __nn_model_handle->interpreter->input(0), len,
-            cfg.is_quantized);
-
-  TfLiteStatus invoke_status = __nn_model_handle->interpreter->Invoke();
-  if (invoke_status != kTfLiteOk) {
-    ESP_LOGE(__FUNCTION__, "Invoke failed");
+  if (invoke(__nn_model_handle, input_data, len) < 0) {
     return -1;
   }
 
-  float *out_buffer = new float[cfg.labels_num];
-  if (!out_buffer) {
-    ESP_LOGE(__FUNCTION__, "unable to allocate out buffer");
-    return -1;
-  }
+  float *out_buffer = __nn_model_handle->out_buffer;
   get_output(__nn_model_handle->interpreter->output(0), out_buffer,
              cfg.labels_num, cfg.is_quantized);
 
   const size_t idx = argmax(out_buffer, cfg.labels_num);
-  char result[32];
-  nn_model_get_label(model_handle, idx, result, sizeof(result));
-
-  ESP_LOGI(__FUNCTION__, "%f, %s, %lld", out_buffer[idx], result,
-           esp_timer_get_time() - t1);
+  // deferred records keep string addresses, labels are static
+  DLOGI(__FUNCTION__, "%f, %s, %lld", out_buffer[idx],
+        cfg.labels ? cfg.labels[idx] : "", esp_timer_get_time() - t1);
   *category = -1;
   if (out_buffer[idx] > cfg.inference_threshold) {
     *category = idx;
   }
-  delete[] out_buffer;
   return 0;
 }
+
+int nn_model_predict(nn_model_handle_t model_handle, const float *input_data,
+                     size_t len, float *scores, size_t *scores_len) {
+  if (!model_handle) {
+    ESP_LOGE(__FUNCTION__, "nn model is not initialized");
+    return -1;
+  }
+  __nn_model_handle_t __nn_model_handle =
+    static_cast<__nn_model_handle_t>(model_handle);
+  nn_model_config_t &cfg = __nn_model_handle->cfg;
+
+  if (*scores_len < cfg.labels_num) {
+    ESP_LOGE(__FUNCTION__, "scores buffer is too small");
+    return -1;
+  }
+  if (invoke(__nn_model_handle, input_data, len) < 0) {
+    return -1;
+  }
+  get_output(__nn_model_handle->interpreter->output(0), scores, cfg.labels_num,
+             cfg.is_quantized);
+  *scores_len = cfg.labels_num;
+  return 0;
+}
+
+float nn_model_get_threshold(nn_model_handle_t model_handle) {
+  if (!model_handle) {
+    ESP_LOGE(__FUNCTION__, "nn model is not initialized");
+    return 1.f;
+  }
+  return static_cast<__nn_model_handle_t>(model_handle)
+    ->cfg.inference_threshold;
+}
+
+static int benchmark_arena(const tflite::Model *model,
+                           const nn_model_config_t &cfg, const float *input,
+                           size_t len, size_t iterations, uint8_t *arena,
+                           size_t arena_size, const char *placement,
+                           size_t *used) {
+  tflite::MicroInterpreter *interpreter =
+    new_interpreter(model, arena, arena_size);
+  if (!interpreter) {
+    ESP_LOGE(__FUNCTION__, "AllocateTensors() failed");
+    return -1;
+  }
+  *used = interpreter->arena_used_bytes();
+  set_input(input, interpreter->input(0), len, cfg.is_quantized);
+
+  int64_t min_us = INT64_MAX, max_us = 0, total_us = 0;
+  for (size_t i = 0; i < iterations; i++) {
+    const int64_t t1 = esp_timer_get_time();
+    if (interpreter->Invoke() != kTfLiteOk) {
+      ESP_LOGE(__FUNCTION__, "Invoke failed");
+      delete interpreter;
+      return -1;
+    }
+    const int64_t us = esp_timer_get_time() - t1;
+    min_us = std::min(min_us, us);
+    max_us = std::max(max_us, us);
+    total_us += us;
+  }
+  ESP_LOGI(__FUNCTION__, "arena %s (%s): avg=%lld, min=%lld, max=%lld us",
+           placement, mem_is_internal(arena) ? "internal" : "psram",
+           total_us / int64_t(iterations), min_us, max_us);
+  delete interpreter;
+  return 0;
+}
+
+int nn_model_benchmark(nn_model_config_t cfg, size_t len, size_t iterations) {
+  const tflite::Model *model = tflite::GetModel(cfg.model_ptr);
+  if (model->version() != TFLITE_SCHEMA_VERSION) {
+    ESP_LOGE(__FUNCTION__, "unsupported schema version %u", model->version());
+    return -1;
+  }
+  iterations = std::max(iterations, size_t(1));
+  float *input = static_cast<float *>(mem_alloc(len * sizeof(float), MEM_HOT));
+  if (!input) {
+    return -1;
+  }
+  memset(input, 0, len * sizeof(float));
+
+  size_t arena_size = 0, used = 0;
+  uint8_t *arena = TensorArena::getBuffer(&arena_size);
+  if (!arena) {
+    mem_free(input);
+    return -1;
+  }
+  int res = benchmark_arena(model, cfg, input, len, iterations, arena,
+                            arena_size, "model", &used);
+  TensorArena::cancelBuffer();
+
+  if (res == 0) {
+    // only what the model used, a second 108 KB arena does not fit the
+    // internal heap when cold memory falls back to it
+    arena_size = TensorArena::align(used) + NN_ARENA_STEP;
+    arena = static_cast<uint8_t *>(mem_alloc(arena_size, MEM_COLD));
+    if (arena) {
+      if (mem_is_internal(arena)) {
+        ESP_LOGW(__FUNCTION__, "no PSRAM, cold arena is internal SRAM too");
+      }
+      res = benchmark_arena(model, cfg, input, len, iterations, arena,
+                            arena_size, "cold", &used);
+      mem_free(arena);
+    } else {
+      ESP_LOGW(__FUNCTION__, "no room for cold arena of %u bytes",
+               arena_size);
+    }
+  }
+  mem_free(input);
+  mem_policy_dump();
+  return res;
+}
@@ -38,6 +38,32 @@ int nn_model_release(nn_model_handle_t model_handle);
  */
 int nn_model_inference(nn_model_handle_t model_handle, const float *input_data,
                        size_t len, int *category);
+/*!
+ * \brief Model inference returning class scores.
+ * \param model_handle NN model handle.
+ * \param input_data input data.
+ * \param len input data len.
+ * \param scores Scores buffer.
+ * \param scores_len In: scores buffer len, out: number of scores.
+ * \return Result.
+ */
+int nn_model_predict(nn_model_handle_t model_handle, const float *input_data,
+                     size_t len, float *scores, size_t *scores_len);
+/*!
+ * \brief Time inference in the free part of the model tensor arena, then in
+ * a cold arena of the size the model used.
+ * \param cfg NN model config.
+ * \param len Input data len.
+ * \param iterations Inferences per placement.
+ * \return Result.
+ */
+int nn_model_benchmark(nn_model_config_t cfg, size_t len, size_t iterations);
+/*!
+ * \brief Get inference threshold.
+ * \param model_handle NN model handle.
+ * \return Threshold.
+ */
+float nn_model_get_threshold(nn_model_handle_t model_handle);
 /*!
  * \brief Get label string.
  * \param model_handle NN model handle.
@@ -1,39 +1,123 @@
 #ifndef _TENSOR_ARENA_H_
 #define _TENSOR_ARENA_H_
 
+#include <algorithm>
+
 #include "esp_log.h"
+#include "mem_policy.h"
 
+/*!
+ * \brief Shared tensor arena. Each model keeps a region of its own, sized to
+ * what its interpreter used, so a small model can share the arena with a big
+ * one. TFLM keeps persistent data at the end of the region it is given, so
+ * regions must not overlap even by the unused part.
+ */
 class TensorArena {
 public:
-  static uint8_t *getBuffer() {
+  /*!
+   * \brief Take the largest free gap of the arena. Keep part of it with
+   * commitBuffer() or give it back with cancelBuffer().
+   * \param size Gap size.
+   */
+  static uint8_t *getBuffer(size_t *size) {
     TensorArena &instance = getInstance();
-    if (!instance.used_) {
-      instance.used_ = true;
-      return instance.buffer_;
-    } else {
+    if (instance.taken_) {
       ESP_LOGW(__FUNCTION__, "Tensor arena buffer is used");
       return nullptr;
     }
+    if (instance.count_ == kMaxRegions_) {
+      ESP_LOGW(__FUNCTION__, "Tensor arena has no free region");
+      return nullptr;
+    }
+    size_t best = 0, best_size = 0, start = 0;
+    for (size_t i = 0; i <= instance.count_; i++) {
+      const size_t end = i < instance.count_ ? instance.regions_[i].offset
+                                             : kTensorArenaSize_;
+      if (end - start > best_size) {
+        best = start;
+        best_size = end - start;
+      }
+      if (i < instance.count_) {
+        start = instance.regions_[i].offset + instance.regions_[i].size;
+      }
+    }
+    instance.taken_ = true;
+    *size = best_size;
+    return &instance.buffer_[best];
+  }
+  /*!
+   * \brief Keep the first used bytes of the buffer from getBuffer() until
+   * releaseBuffer(), the rest is free for the next model.
+   * \param buffer Buffer from getBuffer().
+   * \param used Bytes used by the interpreter, aligned by align().
+   */
+  static void commitBuffer(uint8_t *buffer, size_t used) {
+    TensorArena &instance = getInstance();
+    const size_t offset = buffer - instance.buffer_;
+    size_t i = 0;
+    while (i < instance.count_ && instance.regions_[i].offset < offset) {
+      i++;
+    }
+    std::copy_backward(&instance.regions_[i],
+                       &instance.regions_[instance.count_],
+                       &instance.regions_[instance.count_ + 1]);
+    instance.regions_[i] = {offset, used};
+    instance.count_++;
+    instance.taken_ = false;
+  }
+  /*! \brief Give back the buffer from getBuffer() without keeping any. */
+  static void cancelBuffer() {
+    getInstance().taken_ = false;
+  }
+  /*! \brief Free the region kept by commitBuffer(). */
+  static void releaseBuffer(uint8_t *buffer) {
+    TensorArena &instance = getInstance();
+    const size_t offset = buffer - instance.buffer_;
+    Region *end = &instance.regions_[instance.count_];
+    Region *it = std::find_if(instance.regions_, end, [=](const Region &r) {
+      return r.offset == offset;
+    });
+    if (it == end) {
+      ESP_LOGW(__FUNCTION__, "Tensor arena region %u is not kept", offset);
+      return;
+    }
+    std::copy(it + 1, end, it);
+    instance.count_--;
+  }
+  static constexpr size_t align(size_t size) {
+    return (size + kAlignment_ - 1) & ~(kAlignment_ - 1);
   }
-  static void releaseBuffer() { getInstance().used_ = false; }
-  static size_t getSize() { return kTensorArenaSize_; }
   TensorArena(TensorArena const &) = delete;
   void operator=(TensorArena const &) = delete;
 
 private:
+  struct Region {
+    size_t offset;
+    size_t size;
+  };
   static TensorArena &getInstance() {
     static TensorArena instance;
     return instance;
   }
-  TensorArena() : used_(false) {
-    buffer_ = new uint8_t[kTensorArenaSize_];
-    if (!buffer_) {
-      ESP_LOGE(__FUNCTION__, "Unable to allocate tensor arena buffer");
-    }
+  TensorArena() : taken_(false), count_(0) {
+#if CONFIG_NN_ARENA_PSRAM
+    buffer_ = static_cast<uint8_t *>(mem_alloc(kTensorArenaSize_, MEM_COLD));
+#else
+    // hot, static so the budget is known at link time, see
+    // tools/mem_report.py
+    static uint8_t arena[kTensorArenaSize_]
+      __attribute__((aligned(16), section(".bss.budget.nn_model")));
+    buffer_ = arena;
+#endif
   }
-  bool used_;
-  uint8_t *buffer_;
   static constexpr size_t kTensorArenaSize_ = 108 * 1024;
+  static constexpr size_t kAlignment_ = 16;
+  static constexpr size_t kMaxRegions_ = 4;
+  bool taken_;
+  /*! \brief Kept regions, sorted by offset. */
+  Region regions_[kMaxRegions_];
+  size_t count_;
+  uint8_t *buffer_;
 };
 
-#endif // _TENSOR_ARENA_H_
\ No newline at end of file
+#endif // _TENSOR_ARENA_H_
@@ -3,7 +3,11 @@
 #include "Event.hpp"
 #include "Lcd_GC9D01N.hpp"
 #include "Led_APA102.hpp"
+#include "LogDrain.hpp"
+#include "Tasks.hpp"
 #include "Touch.hpp"
+#include "alloc_track.h"
+#include "assets.h"
 
 #include "i2s_rx_slot.h"
 
@@ -19,6 +23,8 @@ App::App() : current_state_(nullptr) {
   gpio_set_level(LOCK_PIN_INV, 1);
 
   int errors = 0;
+  errors += initLogDrain() < 0;
+  errors += assets_init() < 0;
   transition_queue_ = xQueueCreate(1, sizeof(State *));
   if (transition_queue_ == NULL) {
     ESP_LOGE(TAG, "Error creating transition queue");
@@ -74,6 +80,7 @@ App::~App() {
   releaseTouch();
   releaseStatusMonitor();
   i2s_rx_slot_release();
+  releaseLogDrain();
 }
 
 void App::transition(State *target_state) {
@@ -95,8 +102,19 @@ void App::do_transition(State *target_state) {
 
 void App::run() {
   const TickType_t xTicksToWait = pdMS_TO_TICKS(100);
+#if CONFIG_APP_TASK_STATS_PERIOD_S > 0
+  TickType_t xStatsTime = xTaskGetTickCount();
+#endif
 
   for (;;) {
+#if CONFIG_APP_TASK_STATS_PERIOD_S > 0
+    if (xTaskGetTickCount() - xStatsTime >=
+        pdMS_TO_TICKS(1000 * CONFIG_APP_TASK_STATS_PERIOD_S)) {
+      dumpTaskStats();
+      alloc_track_dump();
+      xStatsTime = xTaskGetTickCount();
+    }
+#endif
     State *target_state = nullptr;
     if (xQueueReceive(transition_queue_, &target_state, 0) == pdPASS) {
       do_transition(target_state);
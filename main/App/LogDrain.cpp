@@ -0,0 +1,55 @@
+#include "LogDrain.hpp"
+#include "Tasks.hpp"
+
+#include "dlog.h"
+
+#include "esp_log.h"
+
+static constexpr char TAG[] = "LogDrain";
+
+// Records per wake up, keeps console writes from hogging the core.
+#define DRAIN_BATCH 32
+
+#if CONFIG_DLOG
+static TaskHandle_t s_task_handle = NULL;
+static uint32_t s_reported_drops = 0;
+
+static void report_drops() {
+  const uint32_t dropped = dlog_dropped();
+  if (dropped != s_reported_drops) {
+    ESP_LOGW(TAG, "%u records dropped", dropped - s_reported_drops);
+    s_reported_drops = dropped;
+  }
+}
+
+static void log_drain_task(void *pvParameters) {
+  for (;;) {
+    if (dlog_drain(DRAIN_BATCH) < DRAIN_BATCH) {
+      report_drops();
+      vTaskDelay(pdMS_TO_TICKS(CONFIG_DLOG_DRAIN_PERIOD_MS));
+    } else {
+      taskYIELD();
+    }
+  }
+}
+
+int initLogDrain() {
+  s_reported_drops = dlog_dropped();
+  if (createTask(eTask::LOG_DRAIN, log_drain_task, NULL, &s_task_handle) !=
+      pdPASS) {
+    return -1;
+  }
+  return 0;
+}
+
+void releaseLogDrain() {
+  deleteTask(eTask::LOG_DRAIN, &s_task_handle);
+  while (dlog_drain(DRAIN_BATCH)) {
+  }
+  report_drops();
+}
+#else
+int initLogDrain() { return 0; }
+
+void releaseLogDrain() {}
+#endif
@@ -1,5 +1,6 @@
 #include "Status.hpp"
 #include "ILed.hpp"
+#include "Tasks.hpp"
 
 #include "i2s_rx_slot.h"
 
@@ -71,21 +72,15 @@ int initStatusMonitor(ILed *p_led) {
     return -1;
   }
 
-  auto xReturned =
-    xTaskCreate(status_monitor_task, "status_monitor_task",
-                configMINIMAL_STACK_SIZE + 512, p_led, 2, &s_task_handle);
-  if (xReturned != pdPASS) {
-    ESP_LOGE(TAG, "Error creating task");
+  if (createTask(eTask::STATUS, status_monitor_task, p_led, &s_task_handle) !=
+      pdPASS) {
     return -1;
   }
   return 0;
 }
 
 void releaseStatusMonitor() {
-  if (s_task_handle) {
-    vTaskDelete(s_task_handle);
-    s_task_handle = NULL;
-  }
+  deleteTask(eTask::STATUS, &s_task_handle);
   if (xStatusEventGroup) {
     vEventGroupDelete(xStatusEventGroup);
     xStatusEventGroup = NULL;
@@ -0,0 +1,181 @@
+#include <cstring>
+
+#include "MemBudget.hpp"
+#include "Tasks.hpp"
+
+#include "esp_log.h"
+
+static constexpr char TAG[] = "Tasks";
+
+struct task_desc_t {
+  const char *name;
+  BaseType_t core;
+  UBaseType_t priority;
+  uint32_t stack_size;
+  StackType_t *stack;
+};
+
+// Stack sizes in bytes, trim them by the "stack ... used" release logs.
+#define VAD_STACK_SZ       (configMINIMAL_STACK_SIZE + 1024 * 5)
+#define KWS_STACK_SZ       (configMINIMAL_STACK_SIZE + 1024 * 4)
+#define KWS_INFER_STACK_SZ (configMINIMAL_STACK_SIZE + 1024 * 4)
+#define KWS_EVENT_STACK_SZ (configMINIMAL_STACK_SIZE + 1024)
+#define SED_PP_STACK_SZ    (configMINIMAL_STACK_SIZE + 1024 * 3)
+#define SED_STACK_SZ       (configMINIMAL_STACK_SIZE + 1024 * 3)
+#define WP_STACK_SZ        (configMINIMAL_STACK_SIZE + 1024)
+#define STATUS_STACK_SZ    (configMINIMAL_STACK_SIZE + 512)
+#define TOUCH_STACK_SZ     (configMINIMAL_STACK_SIZE + 1024 * 2)
+#define LOG_DRAIN_STACK_SZ (configMINIMAL_STACK_SIZE + 1024 * 2)
+
+#define DEFINE_STACK(name, size)                                               \
+  static MEM_BUDGET(stacks) StackType_t name[size]
+
+// Only stacks of the tasks the scenario runs are allocated.
+#if CONFIG_APP_VOICE_RELAY || CONFIG_APP_ENG_TEACHER
+DEFINE_STACK(s_vad_stack, VAD_STACK_SZ);
+DEFINE_STACK(s_kws_stack, KWS_STACK_SZ);
+DEFINE_STACK(s_kws_infer_stack, KWS_INFER_STACK_SZ);
+DEFINE_STACK(s_kws_event_stack, KWS_EVENT_STACK_SZ);
+#define KWS_STACK(name) name
+#else
+#define KWS_STACK(name) NULL
+#endif
+#if CONFIG_APP_SOUND_EVENTS_DETECTION
+DEFINE_STACK(s_sed_pp_stack, SED_PP_STACK_SZ);
+DEFINE_STACK(s_sed_stack, SED_STACK_SZ);
+#define SED_STACK(name) name
+#else
+#define SED_STACK(name) NULL
+#endif
+#if CONFIG_APP_ENG_TEACHER
+DEFINE_STACK(s_wp_stack, WP_STACK_SZ);
+#define WP_STACK(name) name
+#else
+#define WP_STACK(name) NULL
+#endif
+DEFINE_STACK(s_status_stack, STATUS_STACK_SZ);
+DEFINE_STACK(s_touch_stack, TOUCH_STACK_SZ);
+#if CONFIG_DLOG
+DEFINE_STACK(s_log_drain_stack, LOG_DRAIN_STACK_SZ);
+#define DLOG_STACK(name) name
+#else
+#define DLOG_STACK(name) NULL
+#endif
+
+// Capture outranks feature extraction so I2S frames are never dropped,
+// inference gets a core of its own and runs in parallel with both. Deferred
+// log records are emitted by whichever core is idle.
+// Same order as eTask.
+static const task_desc_t s_tasks[] = {
+  {"vad_task", AUDIO_CORE, 5, VAD_STACK_SZ, KWS_STACK(s_vad_stack)},
+  {"kws_task", AUDIO_CORE, 4, KWS_STACK_SZ, KWS_STACK(s_kws_stack)},
+  {"kws_infer_task", INFER_CORE, 3, KWS_INFER_STACK_SZ,
+   KWS_STACK(s_kws_infer_stack)},
+  {"kws_event_task", INFER_CORE, 2, KWS_EVENT_STACK_SZ,
+   KWS_STACK(s_kws_event_stack)},
+  {"pp_task", AUDIO_CORE, 4, SED_PP_STACK_SZ, SED_STACK(s_sed_pp_stack)},
+  {"sed_task", INFER_CORE, 3, SED_STACK_SZ, SED_STACK(s_sed_stack)},
+  {"wp_task", AUDIO_CORE, 5, WP_STACK_SZ, WP_STACK(s_wp_stack)},
+  {"status_monitor_task", INFER_CORE, 1, STATUS_STACK_SZ, s_status_stack},
+  {"touch_event_task", INFER_CORE, 1, TOUCH_STACK_SZ, s_touch_stack},
+  {"log_drain_task", tskNO_AFFINITY, 1, LOG_DRAIN_STACK_SZ,
+   DLOG_STACK(s_log_drain_stack)},
+};
+static_assert(sizeof(s_tasks) / sizeof(s_tasks[0]) == size_t(eTask::NUM),
+              "task table is incomplete");
+
+static StaticTask_t s_tcbs[size_t(eTask::NUM)];
+
+BaseType_t createTask(eTask task, TaskFunction_t fn, void *param,
+                      TaskHandle_t *handle) {
+  const task_desc_t &desc = s_tasks[int(task)];
+  if (!desc.stack) {
+    ESP_LOGE(TAG, "No stack for %s in this scenario", desc.name);
+    return pdFAIL;
+  }
+  *handle = xTaskCreateStaticPinnedToCore(fn, desc.name, desc.stack_size, param,
+                                          desc.priority, desc.stack,
+                                          &s_tcbs[int(task)], desc.core);
+  if (*handle == NULL) {
+    ESP_LOGE(TAG, "Error creating %s", desc.name);
+    return pdFAIL;
+  }
+  return pdPASS;
+}
+
+void deleteTask(eTask task, TaskHandle_t *handle) {
+  if (*handle == NULL) {
+    return;
+  }
+  const task_desc_t &desc = s_tasks[int(task)];
+  // stack type is byte wide, high water mark is in bytes
+  const size_t unused = uxTaskGetStackHighWaterMark(*handle);
+  ESP_LOGI(TAG, "stack %s: %u of %u bytes used", desc.name,
+           desc.stack_size - unused, desc.stack_size);
+  vTaskDelete(*handle);
+  *handle = NULL;
+}
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+#define MAX_TASKS_NUM 32
+
+struct task_run_time_t {
+  TaskHandle_t handle;
+  uint32_t run_time;
+};
+
+static TaskStatus_t s_status[MAX_TASKS_NUM];
+static task_run_time_t s_prev[MAX_TASKS_NUM];
+static size_t s_prev_num = 0;
+static uint32_t s_prev_total = 0;
+
+static uint32_t prev_run_time(TaskHandle_t handle) {
+  for (size_t i = 0; i < s_prev_num; i++) {
+    if (s_prev[i].handle == handle) {
+      return s_prev[i].run_time;
+    }
+  }
+  return 0;
+}
+
+void dumpTaskStats() {
+  uint32_t total = 0;
+  const size_t num = uxTaskGetSystemState(s_status, MAX_TASKS_NUM, &total);
+  const uint32_t elapsed = total - s_prev_total;
+  if (num == 0 || elapsed == 0) {
+    return;
+  }
+
+  // run time counter is wall time, loads are in percent of one core
+  uint32_t busy[portNUM_PROCESSORS] = {0};
+  ESP_LOGI(TAG, "%-16s %4s %4s %6s %6s", "task", "core", "prio", "load%",
+           "stack");
+  for (size_t i = 0; i < num; i++) {
+    const TaskStatus_t &st = s_status[i];
+    const uint32_t run_time = st.ulRunTimeCounter - prev_run_time(st.xHandle);
+    const BaseType_t core = xTaskGetAffinity(st.xHandle);
+    const bool idle = st.uxCurrentPriority == tskIDLE_PRIORITY &&
+                      strncmp(st.pcTaskName, "IDLE", 4) == 0;
+    if (!idle && core >= 0 && core < portNUM_PROCESSORS) {
+      busy[core] += run_time;
+    }
+    ESP_LOGI(TAG, "%-16s %4d %4u %6.1f %6u", st.pcTaskName,
+             core < portNUM_PROCESSORS ? int(core) : -1, st.uxCurrentPriority,
+             run_time * 100.f / elapsed, st.usStackHighWaterMark);
+  }
+  for (size_t core = 0; core < portNUM_PROCESSORS; core++) {
+    ESP_LOGI(TAG, "core%u pinned load=%.1f%%", core,
+             busy[core] * 100.f / elapsed);
+  }
+
+  s_prev_num = num;
+  for (size_t i = 0; i < num; i++) {
+    s_prev[i] = {s_status[i].xHandle, s_status[i].ulRunTimeCounter};
+  }
+  s_prev_total = total;
+}
+#else
+void dumpTaskStats() {
+  ESP_LOGW(TAG, "FreeRTOS run time stats are disabled");
+}
+#endif
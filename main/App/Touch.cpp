@@ -1,6 +1,7 @@
 #include "Touch.hpp"
 #include "Arduino_DriveBus_Library.h"
 #include "Event.hpp"
+#include "Tasks.hpp"
 #include "freertos/projdefs.h"
 
 // device
@@ -16,6 +17,11 @@
 #define TOUCH_CLICK_DURATION_MS       100
 #define TOUCH_SWIPE_DELAY_DURATION_MS 300
 
+// CST816x_RD_DEVICE_GESTUREID values
+#define TOUCH_GESTURE_NONE        0x00
+#define TOUCH_GESTURE_SWIPE_LEFT  0x03
+#define TOUCH_GESTURE_SWIPE_RIGHT 0x04
+
 static constexpr char TAG[] = "Touch";
 
 static std::shared_ptr<Arduino_IIC_DriveBus> IIC_Bus;
@@ -37,18 +43,20 @@ static void touch_event_task(void *pvParameters) {
     vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(10));
 
     if (device->IIC_Interrupt_Flag == true) {
-      const auto gesture = device->IIC_Read_Device_State(
-        device->Arduino_IIC_Touch::Status_Information::TOUCH_GESTURE_ID);
-      ESP_LOGV(TAG, "Gesture: %s", gesture.c_str());
-      if (strcmp(gesture.c_str(), "Swipe Left") == 0) {
+      // raw register read, IIC_Read_Device_State allocates a String
+      uint8_t gesture = TOUCH_GESTURE_NONE;
+      IIC_Bus->IIC_ReadC8D8(CST816D_DEVICE_ADDRESS,
+                            CST816x_RD_DEVICE_GESTUREID, &gesture);
+      ESP_LOGV(TAG, "Gesture: 0x%02x", gesture);
+      if (gesture == TOUCH_GESTURE_SWIPE_LEFT) {
         sendEvent(eEvent::TOUCH_SWIPE_LEFT);
         vTaskDelay(pdMS_TO_TICKS(TOUCH_SWIPE_DELAY_DURATION_MS));
         pendind_click = 0;
-      } else if (strcmp(gesture.c_str(), "Swipe Right") == 0) {
+      } else if (gesture == TOUCH_GESTURE_SWIPE_RIGHT) {
         sendEvent(eEvent::TOUCH_SWIPE_RIGHT);
         vTaskDelay(pdMS_TO_TICKS(TOUCH_SWIPE_DELAY_DURATION_MS));
         pendind_click = 0;
-        // } else if (strcmp(gesture.c_str(), "Single Click") == 0) {
+        // } else if (gesture == TOUCH_GESTURE_SINGLE_CLICK) {
         //   sendEvent(eEvent::TOUCH_CLICK);
       } else { // NONE
         if (!pendind_click) {
@@ -83,11 +91,8 @@ int initTouch() {
     device->Arduino_IIC_Touch::Device::TOUCH_DEVICE_INTERRUPT_MODE,
     device->Arduino_IIC_Touch::Device_Mode::TOUCH_DEVICE_INTERRUPT_PERIODIC);
 
-  auto xReturned = xTaskCreate(touch_event_task, "touch_event_task",
-                               configMINIMAL_STACK_SIZE + 1024 * 2, NULL,
-                               tskIDLE_PRIORITY, &s_task_handle);
-  if (xReturned != pdPASS) {
-    ESP_LOGE(TAG, "Error creating button event task");
+  if (createTask(eTask::TOUCH, touch_event_task, NULL, &s_task_handle) !=
+      pdPASS) {
     return -1;
   }
   return 0;
@@ -97,8 +102,5 @@ void releaseTouch() {
   IIC_Bus.reset();
   delete device;
 
-  if (s_task_handle) {
-    vTaskDelete(s_task_handle);
-    s_task_handle = NULL;
-  }
+  deleteTask(eTask::TOUCH, &s_task_handle);
 }
@@ -0,0 +1,11 @@
+#pragma once
+
+/*!
+ * \brief Start the task emitting deferred log records, see CONFIG_DLOG.
+ * \return Result.
+ */
+int initLogDrain();
+/*!
+ * \brief Stop the drain task and emit records left in the ring.
+ */
+void releaseLogDrain();
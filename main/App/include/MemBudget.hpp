@@ -0,0 +1,9 @@
+#pragma once
+
+/*!
+ * \brief Place zero initialized static buffer of a component in internal
+ * SRAM under .bss.budget.<component>. tools/mem_report.py sums these
+ * sections per component from the linker map.
+ */
+#define MEM_BUDGET(component)                                                  \
+  __attribute__((section(".bss.budget." #component)))
@@ -0,0 +1,49 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*! \brief Capture and feature extraction core. */
+#define AUDIO_CORE 0
+/*! \brief NN inference and UI core. */
+#define INFER_CORE 1
+
+/*!
+ * \brief Application tasks, index in the task table.
+ */
+enum class eTask {
+  VAD,
+  KWS,
+  KWS_INFER,
+  KWS_EVENT,
+  SED_PP,
+  SED,
+  WAV_PLAYER,
+  STATUS,
+  TOUCH,
+  LOG_DRAIN,
+  NUM,
+};
+
+/*!
+ * \brief Create task with core, priority and static stack from the task
+ * table.
+ * \param task Task table entry.
+ * \param fn Task function.
+ * \param param Task param.
+ * \param handle Created task handle.
+ * \return Result of xTaskCreatePinnedToCore.
+ */
+BaseType_t createTask(eTask task, TaskFunction_t fn, void *param,
+                      TaskHandle_t *handle);
+/*!
+ * \brief Log stack high water mark and delete task created by createTask().
+ * \param task Task table entry.
+ * \param handle Task handle, set to NULL.
+ */
+void deleteTask(eTask task, TaskHandle_t *handle);
+/*!
+ * \brief Log per task CPU load, core and stack high water mark and load of
+ * each core since the previous dump. Needs FreeRTOS trace facility and run
+ * time stats, see CONFIG_APP_TASK_STATS.
+ */
+void dumpTaskStats();
@@ -0,0 +1,84 @@
+#include <algorithm>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "AudioSink.hpp"
+#include "dlog.h"
+
+static const char *TAG = "AudioSink";
+
+#if CONFIG_AUDIO_SINK_WAV_FILE
+static const audio_sink_t &s_sink = wav_file_sink;
+#else
+static const audio_sink_t &s_sink = i2s_tx_sink;
+#endif
+
+// written by wp_task, read once the player stopped
+static audio_sink_stats_t s_stats;
+
+int audio_sink_init() {
+  ESP_LOGI(TAG, "Playback to %s", s_sink.name);
+  return s_sink.init();
+}
+
+void audio_sink_release() {
+  s_sink.release();
+}
+
+void audio_sink_start() {
+  s_sink.start();
+}
+
+void audio_sink_stop() {
+  s_sink.stop();
+  const size_t underruns = s_sink.underruns();
+  if (underruns) {
+    ESP_LOGW(TAG, "%u underruns", underruns);
+  }
+  s_stats.underruns += underruns;
+}
+
+int64_t audio_sink_write(const int16_t *data, size_t len) {
+  const int64_t start_us = esp_timer_get_time();
+  const int64_t play_us = s_sink.write(data, len);
+  const int64_t us = esp_timer_get_time() - start_us;
+  s_stats.blocks++;
+  s_stats.write_us_total += us;
+  s_stats.write_us_max = std::max(s_stats.write_us_max, us);
+  DLOGV(TAG, "write: len=%u, us=%lld, play in us=%lld", len, us,
+        play_us - start_us);
+  return play_us;
+}
+
+void audio_sink_flush() {
+  s_sink.flush();
+}
+
+void audio_sink_record_start(int64_t queued_us, int64_t play_us) {
+  const int64_t us = play_us - queued_us;
+  s_stats.starts++;
+  s_stats.start_us_total += us;
+  s_stats.start_us_max = std::max(s_stats.start_us_max, us);
+  DLOGD(TAG, "start: us=%lld", us);
+}
+
+audio_sink_stats_t audio_sink_stats() {
+  return s_stats;
+}
+
+void audio_sink_stats_reset() {
+  s_stats = audio_sink_stats_t{};
+}
+
+void audio_sink_log_stats() {
+  const audio_sink_stats_t &s = s_stats;
+  ESP_LOGI(TAG,
+           "blocks=%u, underruns=%u, write us: avg=%lld, max=%lld, "
+           "starts=%u, start us: avg=%lld, max=%lld",
+           s.blocks, s.underruns,
+           s.blocks ? s.write_us_total / int64_t(s.blocks) : 0,
+           s.write_us_max, s.starts,
+           s.starts ? s.start_us_total / int64_t(s.starts) : 0,
+           s.start_us_max);
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*!
+ * \brief Playback output of the wav player, called by wp_task only. Blocks
+ * are I2S_TX_SAMPLE_LEN samples at I2S_TX_SAMPLE_RATE at most.
+ */
+struct audio_sink_t {
+  const char *name;
+  /*! \return 0 on success, -1 on error. */
+  int (*init)();
+  void (*release)();
+  /*! \brief Playback session starts, the output is idle. */
+  void (*start)();
+  /*! \brief Playback session ended, queued samples keep playing. */
+  void (*stop)();
+  /*!
+   * \brief Queue block, blocks while the output queue is full.
+   * \return Estimated time the first sample is played.
+   */
+  int64_t (*write)(const int16_t *data, size_t len);
+  /*! \brief Silence queued samples. */
+  void (*flush)();
+  /*! \brief Times the output ran dry within a session since start. */
+  size_t (*underruns)();
+};
+
+/*! \brief I2S speaker. */
+extern const audio_sink_t i2s_tx_sink;
+#if CONFIG_AUDIO_SINK_WAV_FILE
+/*! \brief WAV file on the debug host, paced like the I2S DMA ring. */
+extern const audio_sink_t wav_file_sink;
+#endif
+
+/*! \brief Playback timing since audio_sink_stats_reset. */
+struct audio_sink_stats_t {
+  size_t blocks;
+  size_t underruns;
+  int64_t write_us_total;
+  int64_t write_us_max;
+  /*! \brief Playlist entries, from queueing to the first played sample. */
+  size_t starts;
+  int64_t start_us_total;
+  int64_t start_us_max;
+};
+
+/*!
+ * \brief Init the sink selected by CONFIG_AUDIO_SINK.
+ * \return 0 on success, -1 on error.
+ */
+int audio_sink_init();
+/*!
+ * \brief Release the sink.
+ */
+void audio_sink_release();
+/*!
+ * \brief Start playback session.
+ */
+void audio_sink_start();
+/*!
+ * \brief End playback session, counts the underruns it had.
+ */
+void audio_sink_stop();
+/*!
+ * \brief Queue block and time the write.
+ * \param data Samples at I2S_TX_SAMPLE_RATE.
+ * \param len Number of samples, up to I2S_TX_SAMPLE_LEN.
+ * \return Estimated time the first sample is played.
+ */
+int64_t audio_sink_write(const int16_t *data, size_t len);
+/*!
+ * \brief Silence queued samples.
+ */
+void audio_sink_flush();
+/*!
+ * \brief Account start latency of a playlist entry.
+ * \param queued_us Time the entry was queued.
+ * \param play_us Time its first sample is played.
+ */
+void audio_sink_record_start(int64_t queued_us, int64_t play_us);
+/*!
+ * \brief Get playback timing.
+ */
+audio_sink_stats_t audio_sink_stats();
+/*!
+ * \brief Clear playback timing.
+ */
+void audio_sink_stats_reset();
+/*!
+ * \brief Log playback timing.
+ */
+void audio_sink_log_stats();
@@ -1,15 +1,36 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/portmacro.h"
+#include "freertos/queue.h"
 #include "freertos/task.h"
 
 #include "I2sTx.hpp"
 
 #include "driver/gpio.h"
 #include "driver/i2s.h"
+#include "dlog.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "kws_aec.h"
 
 static const char *TAG = "I2sTx";
 
+// i2s_write which waited for a free DMA buffer
+#define I2S_TX_WAIT_US 1000
+// driver events between two writes, one TX_DONE per DMA buffer
+#define I2S_TX_EVENT_QUEUE_LEN (2 * I2S_TX_DMA_BUF_COUNT)
+
+#if CONFIG_KWS_AEC
+static_assert(I2S_TX_SAMPLE_RATE == KWS_AEC_SAMPLE_RATE,
+              "echo reference is played at the microphone rate");
+#endif
+
+/*! \brief Estimated play time of the block following the last written. */
+static int64_t s_next_play_us = 0;
+static QueueHandle_t s_event_queue = NULL;
+static size_t s_underruns = 0;
+/*! \brief No block written since the session started. */
+static bool s_idle = true;
+
 // I2S Configuration
 #if CONFIG_TARGET_LILYGO_T_CIRCLE
 #define I2S_BLK_PIN      GPIO_NUM_5
@@ -25,7 +46,7 @@ static const char *TAG = "I2sTx";
 #define I2S_DATA_IN_PIN I2S_PIN_NO_CHANGE
 #define I2S_SCLK_PIN    I2S_PIN_NO_CHANGE
 
-void i2s_init(void) {
+static int i2s_tx_init() {
   if (GAIN_PIN != GPIO_NUM_NC) {
     gpio_set_direction(GAIN_PIN, GPIO_MODE_OUTPUT);
     gpio_set_level(GAIN_PIN, 0);
@@ -42,7 +63,7 @@ void i2s_init(void) {
     .channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT,
     .communication_format = I2S_COMM_FORMAT_STAND_I2S,
     .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-    .dma_buf_count = 8,
+    .dma_buf_count = I2S_TX_DMA_BUF_COUNT,
     .dma_buf_len = I2S_TX_AUDIO_BUFFER,
     .use_apll = 0,
     .tx_desc_auto_clear = true,
@@ -59,27 +80,101 @@ void i2s_init(void) {
   };
 
   // Call driver installation function before any I2S R/W operation.
-  ESP_ERROR_CHECK(i2s_driver_install(I2S_NUM_0, &i2s_config, 0, NULL));
+  // TX_Q_OVF events report DMA buffers played twice, i.e. underruns
+  ESP_ERROR_CHECK(i2s_driver_install(I2S_NUM_0, &i2s_config,
+                                     I2S_TX_EVENT_QUEUE_LEN, &s_event_queue));
   ESP_ERROR_CHECK(i2s_set_pin(I2S_NUM_0, &pin_config));
   ESP_ERROR_CHECK(i2s_set_clk(I2S_NUM_0, I2S_TX_SAMPLE_RATE,
                               I2S_BITS_PER_SAMPLE_16BIT, I2S_CHANNEL_MONO));
   ESP_ERROR_CHECK(i2s_start(I2S_NUM_0));
+  return 0;
+}
+
+/*!
+ * \brief Estimate play time of the written block. A write which waited for
+ * a free DMA buffer queued the block behind the other ones, otherwise it
+ * follows the previous block or, after a pause, the DMA buffer being played.
+ */
+static int64_t play_time(size_t len, int64_t write_us, int64_t done_us) {
+  int64_t play_us;
+  if (done_us - write_us > I2S_TX_WAIT_US) {
+    play_us = done_us + (I2S_TX_DMA_BUF_COUNT - 1) * I2S_TX_BLOCK_US;
+  } else if (s_next_play_us > done_us) {
+    play_us = s_next_play_us;
+  } else {
+    play_us = done_us + I2S_TX_BLOCK_US / 2;
+  }
+  s_next_play_us = play_us + len * 1000LL / I2S_TX_SAMPLE_KHZ;
+  return play_us;
+}
+
+/*! \brief Count driver events, return underruns among them. */
+static size_t drain_events() {
+  size_t underruns = 0;
+  i2s_event_t event;
+  while (xQueueReceive(s_event_queue, &event, 0) == pdPASS) {
+    underruns += event.type == I2S_EVENT_TX_Q_OVF;
+  }
+  return underruns;
+}
+
+static void i2s_tx_start() {
+  s_underruns = 0;
+  s_idle = true;
+}
+
+static void i2s_tx_stop() {
 }
 
-void i2s_play_wav(const void *data, size_t bytes) {
-  size_t total_wrote_bytes = 0;
-  const size_t samples = bytes / sizeof(int16_t);
-  const int16_t *audio_data = static_cast<const int16_t *>(data);
-  for (size_t i = 0; i < samples; i++) {
-    size_t wrote_bytes = 0;
-    int16_t value = float(audio_data[i]) * VOICE_MSGS_VOLUME;
-    i2s_write(I2S_NUM_0, &value, sizeof(int16_t), &wrote_bytes, portMAX_DELAY);
-    total_wrote_bytes += wrote_bytes;
+static int64_t i2s_tx_write(const int16_t *data, size_t len) {
+  size_t wrote_bytes = 0;
+  const int64_t write_us = esp_timer_get_time();
+  // blocks until the DMA ring has room for the whole block
+  if (i2s_write(I2S_NUM_0, data, len * sizeof(int16_t), &wrote_bytes,
+                portMAX_DELAY) != ESP_OK) {
+    DLOGW(TAG, "i2s_write failed");
   }
-  ESP_LOGV(TAG, "wrote bytes=%d/%d", total_wrote_bytes, bytes);
+  const int64_t play_us = play_time(len, write_us, esp_timer_get_time());
+  // events up to now belong to the blocks written before, the idle ring
+  // replays silence before the first one
+  const size_t underruns = drain_events();
+  if (underruns && !s_idle) {
+    DLOGW(TAG, "underrun: dma buffers=%u", underruns);
+    s_underruns++;
+  }
+  s_idle = false;
+#if CONFIG_KWS_AEC
+  kws_aec_ref_write(data, len, play_us);
+#endif
+  DLOGV(TAG, "wrote bytes=%d", wrote_bytes);
+  return play_us;
 }
 
-void i2s_release(void) {
+static void i2s_tx_flush() {
+  i2s_zero_dma_buffer(I2S_NUM_0);
+#if CONFIG_KWS_AEC
+  kws_aec_ref_cancel(esp_timer_get_time());
+#endif
+  s_next_play_us = 0;
+}
+
+static size_t i2s_tx_underruns() {
+  return s_underruns;
+}
+
+static void i2s_tx_release() {
   ESP_ERROR_CHECK(i2s_stop(I2S_NUM_0));
   ESP_ERROR_CHECK(i2s_driver_uninstall(I2S_NUM_0));
+  s_event_queue = NULL;
 }
+
+const audio_sink_t i2s_tx_sink = {
+  .name = "i2s",
+  .init = i2s_tx_init,
+  .release = i2s_tx_release,
+  .start = i2s_tx_start,
+  .stop = i2s_tx_stop,
+  .write = i2s_tx_write,
+  .flush = i2s_tx_flush,
+  .underruns = i2s_tx_underruns,
+};
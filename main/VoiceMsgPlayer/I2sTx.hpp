@@ -1,19 +1,15 @@
 #pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "AudioSink.hpp"
+
 #define I2S_TX_SAMPLE_RATE  16000
 #define I2S_TX_SAMPLE_LEN   800 // 50ms
 #define I2S_TX_AUDIO_BUFFER I2S_TX_SAMPLE_LEN
+/*! \brief Playback block, one DMA buffer and one i2s_write. */
+#define I2S_TX_BLOCK_BYTES (I2S_TX_SAMPLE_LEN * sizeof(int16_t))
 
-/*!
- * \brief Init i2s tx driver.
- */
-void i2s_init(void);
-/*!
- * \brief Release i2s tx driver.
- */
-void i2s_release(void);
-/*!
- * \brief Play wav sample.
- * \param data Data pointer.
- * \param bytes Sample size.
- */
-void i2s_play_wav(const void *data, size_t bytes);
+#define I2S_TX_DMA_BUF_COUNT 8
+#define I2S_TX_SAMPLE_KHZ    (I2S_TX_SAMPLE_RATE / 1000)
+#define I2S_TX_BLOCK_US      (I2S_TX_SAMPLE_LEN * 1000LL / I2S_TX_SAMPLE_KHZ)
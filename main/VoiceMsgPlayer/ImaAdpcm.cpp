@@ -0,0 +1,81 @@
+#include <algorithm>
+
+#include "ImaAdpcm.hpp"
+
+#define IMA_BLOCK_HEADER_SZ 4
+
+static const int8_t s_index_table[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+static const int16_t s_step_table[89] = {
+  7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+  19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+  50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+  130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+  337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+  876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+  2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+  5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+  15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static inline int16_t decode_nibble(ima_adpcm_stream_t *stream,
+                                    uint8_t nibble) {
+  const int32_t step = s_step_table[stream->step_index];
+  int32_t diff = step >> 3;
+  if (nibble & 4) {
+    diff += step;
+  }
+  if (nibble & 2) {
+    diff += step >> 1;
+  }
+  if (nibble & 1) {
+    diff += step >> 2;
+  }
+  const int32_t predictor =
+    nibble & 8 ? stream->predictor - diff : stream->predictor + diff;
+  stream->predictor = std::min(std::max(predictor, -32768), 32767);
+  stream->step_index =
+    std::min(std::max(stream->step_index + s_index_table[nibble & 7], 0), 88);
+  return int16_t(stream->predictor);
+}
+
+void ima_adpcm_init(ima_adpcm_stream_t *stream, const void *data, size_t bytes,
+                    size_t block_align) {
+  stream->data = static_cast<const uint8_t *>(data);
+  stream->bytes = bytes;
+  stream->block_align = block_align;
+  stream->block = 0;
+  stream->sample = 0;
+  stream->predictor = 0;
+  stream->step_index = 0;
+}
+
+size_t ima_adpcm_decode(ima_adpcm_stream_t *stream, int16_t *dst, size_t len) {
+  size_t produced = 0;
+  while (produced < len &&
+         stream->block + IMA_BLOCK_HEADER_SZ <= stream->bytes) {
+    const uint8_t *block = &stream->data[stream->block];
+    const size_t block_bytes =
+      std::min(stream->block_align, stream->bytes - stream->block);
+    if (stream->sample == 0) {
+      stream->predictor = int16_t(block[0] | block[1] << 8);
+      stream->step_index = std::min<int32_t>(block[2], 88);
+      dst[produced++] = int16_t(stream->predictor);
+      stream->sample = 1;
+      continue;
+    }
+    // two samples per byte, low nibble first
+    const size_t block_samples = 1 + (block_bytes - IMA_BLOCK_HEADER_SZ) * 2;
+    const size_t n = std::min(len - produced, block_samples - stream->sample);
+    const uint8_t *nibbles = &block[IMA_BLOCK_HEADER_SZ];
+    for (size_t i = stream->sample - 1; i < stream->sample - 1 + n; i++) {
+      const uint8_t byte = nibbles[i >> 1];
+      dst[produced++] = decode_nibble(stream, i & 1 ? byte >> 4 : byte & 0xf);
+    }
+    stream->sample += n;
+    if (stream->sample == block_samples) {
+      stream->block += stream->block_align;
+      stream->sample = 0;
+    }
+  }
+  return produced;
+}
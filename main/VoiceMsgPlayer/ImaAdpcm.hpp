@@ -0,0 +1,34 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*! \brief Decoder position in IMA-ADPCM mono blocks. */
+struct ima_adpcm_stream_t {
+  const uint8_t *data;
+  size_t bytes;
+  size_t block_align;
+  /*! \brief Offset of the current block. */
+  size_t block;
+  /*! \brief Next sample in the current block, 0 is the header one. */
+  size_t sample;
+  int32_t predictor;
+  int32_t step_index;
+};
+
+/*!
+ * \brief Start decoding at the first block.
+ * \param stream Decoder state.
+ * \param data Whole blocks, the last one may be short.
+ * \param bytes Data size.
+ * \param block_align Block size from the fmt chunk.
+ */
+void ima_adpcm_init(ima_adpcm_stream_t *stream, const void *data, size_t bytes,
+                    size_t block_align);
+/*!
+ * \brief Decode next samples, continues across blocks.
+ * \param stream Decoder state.
+ * \param dst Output PCM.
+ * \param len Max number of samples.
+ * \return Number of decoded samples, 0 at the end of data.
+ */
+size_t ima_adpcm_decode(ima_adpcm_stream_t *stream, int16_t *dst, size_t len);
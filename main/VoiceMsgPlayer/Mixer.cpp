@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cstring>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "I2sTx.hpp"
+#include "ImaAdpcm.hpp"
+#include "MemBudget.hpp"
+#include "Mixer.hpp"
+#include "Resampler.hpp"
+#include "dlog.h"
+
+static const char *TAG = "Mixer";
+
+struct mixer_voice_t {
+  bool active;
+  Sample_t sample;
+  /*! \brief Consumed PCM bytes, samples of a stream. */
+  size_t pos;
+  ima_adpcm_stream_t adpcm;
+  bool resample;
+  resampler_t rs;
+  /*! \brief Gain reached at the end of the previous block, -1 before the
+   * first one. */
+  int32_t gain_q15;
+};
+
+struct mixer_stats_t {
+  size_t blocks;
+  size_t max_voices;
+  int64_t total_us;
+  int64_t max_us;
+} static s_stats;
+
+// wp_task is the only user, no locking
+static MEM_BUDGET(wav_player) mixer_voice_t s_voices[MIXER_VOICES];
+static MEM_BUDGET(wav_player) int32_t s_acc[I2S_TX_SAMPLE_LEN];
+static MEM_BUDGET(wav_player) int16_t s_voice_block[I2S_TX_SAMPLE_LEN];
+
+/*! \brief Source samples of the voice at the entry rate. */
+static size_t voice_read(void *ctx, int16_t *dst, size_t len) {
+  mixer_voice_t *voice = static_cast<mixer_voice_t *>(ctx);
+  const Sample_t &sample = voice->sample;
+  if (sample.format == WAV_FORMAT_IMA_ADPCM) {
+    return ima_adpcm_decode(&voice->adpcm, dst, len);
+  }
+  if (sample.format == SAMPLE_FORMAT_STREAM) {
+    const auto *stream = static_cast<const sample_stream_t *>(sample.data);
+    len = stream->read(stream->ctx, voice->pos, dst, len);
+    voice->pos += len;
+    return len;
+  }
+  len = std::min(len, (sample.bytes - voice->pos) / sizeof(int16_t));
+  memcpy(dst, static_cast<const uint8_t *>(sample.data) + voice->pos,
+         len * sizeof(int16_t));
+  voice->pos += len * sizeof(int16_t);
+  return len;
+}
+
+/*! \brief Voice samples at the output rate, less than len at the end. */
+static size_t voice_render(mixer_voice_t *voice, int16_t *dst, size_t len) {
+  if (voice->resample) {
+    return resampler_process(&voice->rs, dst, len, voice_read, voice);
+  }
+  size_t done = 0;
+  while (done < len) {
+    const size_t n = voice_read(voice, &dst[done], len - done);
+    if (n == 0) {
+      break;
+    }
+    done += n;
+  }
+  return done;
+}
+
+/*! \brief Entry gain ducked by the other active voices. */
+static int32_t voice_target_gain(const mixer_voice_t *voice) {
+  int32_t gain = voice->sample.gain_q15;
+  for (const auto &other : s_voices) {
+    if (other.active && &other != voice) {
+      gain = (gain * other.sample.duck_q15) >> 15;
+    }
+  }
+  return gain;
+}
+
+bool mixer_can_start(const Sample_t &sample) {
+  bool free = false;
+  for (const auto &voice : s_voices) {
+    if (!voice.active) {
+      free = true;
+    } else if (!sample.overlay && !voice.sample.overlay) {
+      return false;
+    }
+  }
+  return free;
+}
+
+bool mixer_start(const Sample_t &sample) {
+  for (auto &voice : s_voices) {
+    if (voice.active) {
+      continue;
+    }
+    voice.sample = sample;
+    voice.pos = 0;
+    if (sample.format == WAV_FORMAT_IMA_ADPCM) {
+      ima_adpcm_init(&voice.adpcm, sample.data, sample.bytes,
+                     sample.block_align);
+    }
+    voice.resample = sample.sample_rate != I2S_TX_SAMPLE_RATE;
+    if (voice.resample) {
+      resampler_init(&voice.rs, sample.sample_rate, I2S_TX_SAMPLE_RATE);
+    }
+    voice.gain_q15 = -1;
+    voice.active = true;
+    return true;
+  }
+  return false;
+}
+
+size_t mixer_render(int16_t *dst, size_t len) {
+  const int64_t start_us = esp_timer_get_time();
+  len = std::min(len, size_t(I2S_TX_SAMPLE_LEN));
+  memset(s_acc, 0, len * sizeof(int32_t));
+
+  size_t out_len = 0;
+  size_t voices = 0;
+  int32_t targets[MIXER_VOICES];
+  for (size_t v = 0; v < MIXER_VOICES; v++) {
+    targets[v] = voice_target_gain(&s_voices[v]);
+  }
+  for (size_t v = 0; v < MIXER_VOICES; v++) {
+    auto &voice = s_voices[v];
+    if (!voice.active) {
+      continue;
+    }
+    const size_t n = voice_render(&voice, s_voice_block, len);
+    if (voice.gain_q15 < 0) {
+      voice.gain_q15 = targets[v];
+    }
+    // ducking ramps over the block instead of clicking
+    int32_t gain_q30 = voice.gain_q15 << 15;
+    const int32_t step =
+      (targets[v] - voice.gain_q15) * (1 << 15) / int32_t(len);
+    for (size_t i = 0; i < n; i++) {
+      s_acc[i] += (int32_t(s_voice_block[i]) * (gain_q30 >> 15)) >> 15;
+      gain_q30 += step;
+    }
+    voice.gain_q15 = targets[v];
+    if (n < len) {
+      voice.active = false;
+    }
+    out_len = std::max(out_len, n);
+    voices++;
+  }
+  for (size_t i = 0; i < out_len; i++) {
+    dst[i] = int16_t(std::max(std::min(s_acc[i], int32_t(INT16_MAX)),
+                              int32_t(INT16_MIN)));
+  }
+
+  if (out_len) {
+    const int64_t us = esp_timer_get_time() - start_us;
+    s_stats.blocks++;
+    s_stats.max_voices = std::max(s_stats.max_voices, voices);
+    s_stats.total_us += us;
+    s_stats.max_us = std::max(s_stats.max_us, us);
+    DLOGV(TAG, "block: voices=%u, len=%u, us=%lld", voices, out_len, us);
+  }
+  return out_len;
+}
+
+void mixer_reset() {
+  for (auto &voice : s_voices) {
+    voice.active = false;
+  }
+}
+
+void mixer_log_stats() {
+  if (s_stats.blocks == 0) {
+    return;
+  }
+  ESP_LOGI(TAG, "blocks=%u, voices max=%u, us/block: avg=%lld, max=%lld",
+           s_stats.blocks, s_stats.max_voices,
+           s_stats.total_us / s_stats.blocks, s_stats.max_us);
+  s_stats = mixer_stats_t{};
+}
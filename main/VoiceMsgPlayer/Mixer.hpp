@@ -0,0 +1,37 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Types.hpp"
+
+#define MIXER_VOICES 4
+
+/*!
+ * \brief Check whether playlist entry may start now: overlays need a free
+ * voice, other entries also wait for the previous non overlay one.
+ * \param sample Playlist entry.
+ * \return Entry may start.
+ */
+bool mixer_can_start(const Sample_t &sample);
+/*!
+ * \brief Start playing entry on a free voice.
+ * \param sample PCM, IMA-ADPCM or stream entry, mono.
+ * \return Voice was free.
+ */
+bool mixer_start(const Sample_t &sample);
+/*!
+ * \brief Mix next block of active voices at I2S_TX_SAMPLE_RATE. Gains
+ * change linearly over the block.
+ * \param dst Output samples.
+ * \param len Max number of samples.
+ * \return Number of samples, 0 when no voice is active.
+ */
+size_t mixer_render(int16_t *dst, size_t len);
+/*!
+ * \brief Stop all voices.
+ */
+void mixer_reset();
+/*!
+ * \brief Log mixing cost per block since the last call.
+ */
+void mixer_log_stats();
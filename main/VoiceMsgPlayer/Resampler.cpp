@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Resampler.hpp"
+
+#define RESAMPLER_ZERO_CROSSINGS 8
+#define RESAMPLER_PHASES         32 // table points per zero crossing
+#define RESAMPLER_TABLE_LEN      (RESAMPLER_ZERO_CROSSINGS * RESAMPLER_PHASES)
+// passband edge relative to the lower Nyquist frequency
+#define RESAMPLER_BANDWIDTH 0.9f
+
+/*! \brief One side of the Blackman windowed sinc, one guard point. */
+static float s_table[RESAMPLER_TABLE_LEN + 2];
+static bool s_table_ready = false;
+
+static void init_table() {
+  const float pi = 3.14159265f;
+  for (size_t i = 0; i <= RESAMPLER_TABLE_LEN; i++) {
+    const float x = float(i) / RESAMPLER_PHASES;
+    const float sinc = i ? sinf(pi * x) / (pi * x) : 1.f;
+    const float w = x / RESAMPLER_ZERO_CROSSINGS;
+    const float window =
+      0.42f + 0.5f * cosf(pi * w) + 0.08f * cosf(2.f * pi * w);
+    s_table[i] = sinc * window;
+  }
+  s_table[RESAMPLER_TABLE_LEN + 1] = 0.f;
+  s_table_ready = true;
+}
+
+void resampler_init(resampler_t *rs, uint32_t in_rate, uint32_t out_rate) {
+  if (!s_table_ready) {
+    init_table();
+  }
+  in_rate = std::min(std::max(in_rate, uint32_t(RESAMPLER_MIN_RATE)),
+                     uint32_t(RESAMPLER_MAX_RATE));
+  const uint64_t step = (uint64_t(in_rate) << 32) / out_rate;
+  rs->step_int = uint32_t(step >> 32);
+  rs->step_frac = uint32_t(step);
+  rs->cutoff =
+    RESAMPLER_BANDWIDTH * std::min(1.f, float(out_rate) / float(in_rate));
+  rs->half_len = size_t(ceilf(RESAMPLER_ZERO_CROSSINGS / rs->cutoff));
+  // history before the first sample is silence
+  memset(rs->buf, 0, rs->half_len * sizeof(int16_t));
+  rs->filled = rs->half_len;
+  rs->pos = rs->half_len;
+  rs->frac = 0;
+  rs->end = 0;
+  rs->eof = false;
+}
+
+/*! \brief Make buf hold the filter span around pos. */
+static void refill(resampler_t *rs, resampler_pull_t pull, void *ctx) {
+  const size_t drop = rs->pos + 1 - rs->half_len;
+  memmove(rs->buf, &rs->buf[drop], (rs->filled - drop) * sizeof(int16_t));
+  rs->pos -= drop;
+  rs->filled -= drop;
+  if (rs->eof) {
+    rs->end -= drop;
+  } else {
+    while (rs->filled < RESAMPLER_BUF_LEN) {
+      const size_t len = pull(ctx, &rs->buf[rs->filled],
+                              RESAMPLER_BUF_LEN - rs->filled);
+      if (len == 0) {
+        rs->eof = true;
+        rs->end = rs->filled;
+        break;
+      }
+      rs->filled += len;
+    }
+  }
+  if (rs->eof) {
+    // the filter rings out over silence
+    memset(&rs->buf[rs->filled], 0,
+           (RESAMPLER_BUF_LEN - rs->filled) * sizeof(int16_t));
+    rs->filled = RESAMPLER_BUF_LEN;
+  }
+}
+
+size_t resampler_process(resampler_t *rs, int16_t *dst, size_t len,
+                         resampler_pull_t pull, void *ctx) {
+  const float scale = rs->cutoff * RESAMPLER_PHASES;
+  const int half_len = int(rs->half_len);
+  for (size_t n = 0; n < len; n++) {
+    if (rs->eof && rs->pos >= rs->end) {
+      return n;
+    }
+    if (rs->pos + rs->half_len >= rs->filled) {
+      refill(rs, pull, ctx);
+      if (rs->eof && rs->pos >= rs->end) {
+        return n;
+      }
+    }
+    const float frac = rs->frac * (1.f / 4294967296.f);
+    const int16_t *center = &rs->buf[rs->pos];
+    float acc = 0.f;
+    for (int k = 1 - half_len; k <= half_len; k++) {
+      const float u = fabsf(k - frac) * scale;
+      const size_t idx = size_t(u);
+      if (idx >= RESAMPLER_TABLE_LEN) {
+        continue;
+      }
+      const float t = u - idx;
+      const float h = s_table[idx] + t * (s_table[idx + 1] - s_table[idx]);
+      acc += center[k] * h;
+    }
+    acc *= rs->cutoff;
+    dst[n] = int16_t(std::max(std::min(acc, 32767.f), -32768.f));
+
+    const uint32_t frac_prev = rs->frac;
+    rs->frac += rs->step_frac;
+    rs->pos += rs->step_int + (rs->frac < frac_prev);
+  }
+  return len;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define RESAMPLER_MIN_RATE 8000
+#define RESAMPLER_MAX_RATE 48000
+#define RESAMPLER_BUF_LEN  256
+
+/*!
+ * \brief Pull callback of the resampler source.
+ * \return Number of samples written to dst, 0 at the end of source.
+ */
+typedef size_t (*resampler_pull_t)(void *ctx, int16_t *dst, size_t len);
+
+/*!
+ * \brief Windowed sinc resampler evaluated from a polyphase table with
+ * linear interpolation between phases, any rate ratio.
+ */
+struct resampler_t {
+  /*! \brief Input samples, history of the filter included. */
+  int16_t buf[RESAMPLER_BUF_LEN];
+  size_t filled;
+  /*! \brief Input sample at or before the output time. */
+  size_t pos;
+  /*! \brief Output time past pos, Q32. */
+  uint32_t frac;
+  /*! \brief Input samples per output sample, Q32 fraction. */
+  uint32_t step_int;
+  uint32_t step_frac;
+  /*! \brief Filter half length in input samples. */
+  size_t half_len;
+  /*! \brief Cutoff relative to the input Nyquist frequency. */
+  float cutoff;
+  /*! \brief End of input in buf, valid once eof is set. */
+  size_t end;
+  bool eof;
+};
+
+/*!
+ * \brief Start converting a new source.
+ * \param rs Resampler state.
+ * \param in_rate Source rate, RESAMPLER_MIN_RATE to RESAMPLER_MAX_RATE.
+ * \param out_rate Output rate.
+ */
+void resampler_init(resampler_t *rs, uint32_t in_rate, uint32_t out_rate);
+/*!
+ * \brief Produce output samples, pulls the source as needed.
+ * \param rs Resampler state.
+ * \param dst Output samples.
+ * \param len Max number of output samples.
+ * \param pull Source callback.
+ * \param ctx Source callback context.
+ * \return Number of output samples, less than len at the end of source.
+ */
+size_t resampler_process(resampler_t *rs, int16_t *dst, size_t len,
+                         resampler_pull_t pull, void *ctx);
@@ -2,23 +2,50 @@
 #include "stdint.h"
 #include "stdio.h"
 
+#define WAV_FORMAT_PCM       0x0001
+#define WAV_FORMAT_IMA_ADPCM 0x0011
+/*! \brief Not a WAV format, entry data is a sample_stream_t. */
+#define SAMPLE_FORMAT_STREAM 0xffff
+
+/*! \brief Pull source of a playlist entry, e.g. a recording. */
+struct sample_stream_t {
+  /*!
+   * \brief Read samples from pos on.
+   * \return Number of samples, less than len at the end.
+   */
+  size_t (*read)(void *ctx, size_t pos, int16_t *dst, size_t len);
+  void *ctx;
+  uint32_t sample_rate;
+};
+
+/*! \brief Playlist entry, a whole prompt played in place. */
 struct Sample_t {
   const void *data;
   size_t bytes;
+  /*! \brief WAV_FORMAT_* or SAMPLE_FORMAT_STREAM, block_align is used by
+   * IMA-ADPCM only. */
+  uint16_t format;
+  uint16_t block_align;
+  uint32_t sample_rate;
+  /*! \brief Volume in Q15, up to 1.0. */
+  int16_t gain_q15;
+  /*! \brief Gain of the other voices while this one plays, Q15. */
+  int16_t duck_q15;
+  /*! \brief Starts over the playing entries instead of after them. */
+  bool overlay;
+  /*! \brief esp_timer time the entry was queued, for start latency. */
+  int64_t queued_us;
 };
 
-struct wav_header_t {
-  char chunkID[4]; // "RIFF" = 0x46464952
-  uint32_t chunkSize;
-  char format[4];      // "WAVE" = 0x45564157
-  char subchunk1ID[4]; // "fmt " = 0x20746D66
-  uint32_t subchunk1Size;
-  uint16_t audioFormat;
-  uint16_t numChannels;
-  uint32_t sampleRate;
-  uint32_t byteRate;
-  uint16_t blockAlign;
-  uint16_t bitsPerSample;
-  char subchunk2ID[4]; // "data" = 0x61746164
-  uint32_t subchunk2Size;
+/*!
+ * \brief Prompt of a wav samples table, generated at build time by
+ * tools/pack_assets.py from the RIFF chunks.
+ */
+struct wav_prompt_t {
+  /*! \brief Offset of the data chunk body from the asset bundle start. */
+  uint32_t data_offset;
+  uint32_t data_bytes;
+  uint32_t sample_rate;
+  uint16_t format;
+  uint16_t block_align;
 };
@@ -1,45 +1,99 @@
 #include "VoiceMsgPlayer.hpp"
+#include "AudioSink.hpp"
 #include "I2sTx.hpp"
 #include "Types.hpp"
 
-#include "string.h"
+#include <algorithm>
+
+#include "assets.h"
+#include "esp_timer.h"
 
 static const char *TAG = "VoiceMsgPlayer";
 
-void VoiceMsgPlay(wav_samples_table_t table, VoiceMsgId id) {
-  ESP_LOGD(TAG, "play msg: %u", id);
-  if (id == 0 || id > table.samples_num)
-    return;
+static int16_t to_q15(float gain) {
+  return int16_t(std::min(std::max(gain, 0.f), 1.f) * 32767);
+}
+
+/*!
+ * \brief Find prompt index of the table.
+ * \return Number of prompts, 0 when missing.
+ */
+static size_t find_index(wav_samples_table_t table,
+                         const wav_prompt_t **index) {
+  asset_t asset;
+  if (assets_find(table.name, ASSET_PROMPT_INDEX, &asset) < 0) {
+    return 0;
+  }
+  *index = static_cast<const wav_prompt_t *>(asset.data);
+  return asset.size / sizeof(wav_prompt_t);
+}
+
+static bool enqueue(wav_samples_table_t table, VoiceMsgId id, float gain,
+                    float duck, bool overlay) {
+  ESP_LOGD(TAG, "play msg: %s/%u", table.name, id);
+  const wav_prompt_t *index;
+  if (id == 0 || id > find_index(table, &index))
+    return false;
   const auto xBits = xEventGroupGetBits(xWavPlayerEventGroup);
   if (xBits & WAV_PLAYER_MUTED_MSK) {
-    return;
-  }
-  VoiceMsgId array_idx = id - 1;
-  wav_header_t header;
-  memcpy(&header, table.wav_samples[array_idx], sizeof(wav_header_t));
-  Sample_t wav = {.data = table.wav_samples[array_idx] + sizeof(wav_header_t),
-                  .bytes = header.subchunk2Size};
-  for (size_t i = 0; i < wav.bytes / I2S_TX_AUDIO_BUFFER; i++) {
-    const uint8_t *ptr =
-      static_cast<const uint8_t *>(wav.data) + i * I2S_TX_AUDIO_BUFFER;
-    Sample_t sample = {.data = ptr, .bytes = I2S_TX_AUDIO_BUFFER};
-    xQueueSend(xWavPlayerQueue, &sample, portMAX_DELAY);
-    ESP_LOGV(TAG, "send[%d]=%d", i, I2S_TX_AUDIO_BUFFER);
-  }
-  const size_t rem = wav.bytes % I2S_TX_AUDIO_BUFFER;
-  if (rem != 0) {
-    const uint8_t *ptr =
-      static_cast<const uint8_t *>(wav.data) + wav.bytes - rem;
-    Sample_t sample = {.data = ptr, .bytes = rem};
-    xQueueSend(xWavPlayerQueue, &sample, portMAX_DELAY);
-    ESP_LOGV(TAG, "send[-]=%d", rem);
+    return false;
   }
+  // headers were parsed and checked at build time
+  const wav_prompt_t &prompt = index[id - 1];
+  const Sample_t sample = {
+    .data = assets_at(prompt.data_offset),
+    .bytes = prompt.data_bytes,
+    .format = prompt.format,
+    .block_align = prompt.block_align,
+    .sample_rate = prompt.sample_rate,
+    .gain_q15 = to_q15(gain),
+    .duck_q15 = to_q15(duck),
+    .overlay = overlay,
+    .queued_us = esp_timer_get_time()};
+  // the player walks the prompt in place, enqueueing never blocks
+  if (xQueueSend(xWavPlayerQueue, &sample, 0) != pdPASS) {
+    ESP_LOGW(TAG, "playlist is full, msg %u dropped", id);
+    return false;
+  }
+  return true;
+}
+
+bool VoiceMsgPlay(wav_samples_table_t table, VoiceMsgId id, float gain) {
+  return enqueue(table, id, gain, 1.f, false);
+}
+
+bool VoiceMsgOverlay(wav_samples_table_t table, VoiceMsgId id, float gain,
+                     float duck) {
+  return enqueue(table, id, gain, duck, true);
+}
+
+bool VoiceMsgPlayStream(const sample_stream_t *stream, float gain) {
+  const auto xBits = xEventGroupGetBits(xWavPlayerEventGroup);
+  if (xBits & WAV_PLAYER_MUTED_MSK) {
+    return false;
+  }
+  const Sample_t sample = {
+    .data = stream,
+    .bytes = 0,
+    .format = SAMPLE_FORMAT_STREAM,
+    .block_align = 0,
+    .sample_rate = stream->sample_rate,
+    .gain_q15 = to_q15(gain),
+    .duck_q15 = to_q15(1.f),
+    .overlay = false,
+    .queued_us = esp_timer_get_time()};
+  if (xQueueSend(xWavPlayerQueue, &sample, 0) != pdPASS) {
+    ESP_LOGW(TAG, "playlist is full, stream dropped");
+    return false;
+  }
+  return true;
 }
 
 void VoiceMsgStop() {
-  if (size_t samples_num = uxQueueMessagesWaiting(xWavPlayerQueue)) {
-    ESP_LOGD(TAG, "dropped samples=%d", samples_num);
-    xQueueReset(xWavPlayerQueue);
+  xQueueReset(xWavPlayerQueue);
+  if (!(xEventGroupGetBits(xWavPlayerEventGroup) & WAV_PLAYER_STOP_MSK)) {
+    // the player stops after the current DMA block
+    xEventGroupSetBits(xWavPlayerEventGroup, WAV_PLAYER_ABORT_MSK);
     VoiceMsgWaitStop(portMAX_DELAY);
   }
 }
@@ -50,6 +104,11 @@ bool VoiceMsgWaitStop(size_t xTicks) {
   return xBits & WAV_PLAYER_STOP_MSK;
 }
 
+size_t VoiceMsgTableSize(wav_samples_table_t table) {
+  const wav_prompt_t *index;
+  return find_index(table, &index);
+}
+
 void VoiceMsgMutePlayer(bool state) {
   if (state) {
     ESP_LOGD(TAG, "player is muted");
@@ -59,3 +118,38 @@ void VoiceMsgMutePlayer(bool state) {
     xEventGroupClearBits(xWavPlayerEventGroup, WAV_PLAYER_MUTED_MSK);
   }
 }
+
+int VoiceMsgPlaybackCheck(const wav_samples_table_t *tables,
+                          size_t tables_num, int64_t max_start_us) {
+  size_t prompts = 0;
+  size_t failed = 0;
+  audio_sink_stats_reset();
+  for (size_t t = 0; t < tables_num; t++) {
+    const size_t samples_num = VoiceMsgTableSize(tables[t]);
+    for (VoiceMsgId id = 1; id <= samples_num; id++) {
+      prompts++;
+      if (!VoiceMsgPlay(tables[t], id)) {
+        failed++;
+        continue;
+      }
+      // the stop bit is cleared before the entry leaves the playlist
+      while (uxQueueMessagesWaiting(xWavPlayerQueue)) {
+        vTaskDelay(1);
+      }
+      VoiceMsgWaitStop(portMAX_DELAY);
+    }
+  }
+  const audio_sink_stats_t stats = audio_sink_stats();
+  audio_sink_log_stats();
+  if (failed || stats.starts != prompts || stats.underruns ||
+      stats.start_us_max > max_start_us) {
+    ESP_LOGE(TAG,
+             "playback check failed: prompts=%u, not queued=%u, started=%u, "
+             "underruns=%u, start max us=%lld, bound us=%lld",
+             prompts, failed, stats.starts, stats.underruns,
+             stats.start_us_max, max_start_us);
+    return -1;
+  }
+  ESP_LOGI(TAG, "playback check passed: prompts=%u", prompts);
+  return 0;
+}
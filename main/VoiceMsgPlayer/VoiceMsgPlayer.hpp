@@ -1,21 +1,45 @@
 #pragma once
+#include "Types.hpp"
 #include "WavPlayer.hpp"
 
 struct wav_samples_table_t {
-  const unsigned char **wav_samples;
-  const unsigned int samples_num;
+  /*! \brief Prompt index in the asset bundle, ids start at 1. */
+  const char *name;
 };
 
 using VoiceMsgId = size_t;
 
 /*!
- * \brief Play wav from table.
+ * \brief Append wav from table to the playlist, does not block.
  * \param table Wav samples table.
  * \param id Sample id.
+ * \param gain Volume, 0 to 1.
+ * \return Wav is queued.
  */
-void VoiceMsgPlay(wav_samples_table_t table, VoiceMsgId id);
+bool VoiceMsgPlay(wav_samples_table_t table, VoiceMsgId id,
+                  float gain = VOICE_MSGS_VOLUME);
 /*!
- * \brief Stop playback.
+ * \brief Play wav from table over the playing ones, e.g. a chime over a
+ * prompt, does not block.
+ * \param table Wav samples table.
+ * \param id Sample id.
+ * \param gain Volume, 0 to 1.
+ * \param duck Volume of the other wavs while this one plays, 0 to 1.
+ * \return Wav is queued.
+ */
+bool VoiceMsgOverlay(wav_samples_table_t table, VoiceMsgId id,
+                     float gain = VOICE_MSGS_VOLUME, float duck = 0.5f);
+/*!
+ * \brief Append stream to the playlist, e.g. a recording, does not block.
+ * \param stream Source, valid until played or the playlist is cleared.
+ * \param gain Volume, 0 to 1.
+ * \return Stream is queued.
+ */
+bool VoiceMsgPlayStream(const sample_stream_t *stream,
+                        float gain = VOICE_MSGS_VOLUME);
+/*!
+ * \brief Clear the playlist and stop the playing wavs after the DMA block
+ * being written.
  */
 void VoiceMsgStop();
 /*!
@@ -29,3 +53,20 @@ bool VoiceMsgWaitStop(size_t xTicks);
  * \param state on or off.
  */
 void VoiceMsgMutePlayer(bool state);
+/*!
+ * \brief Get number of prompts of the table.
+ * \param table Wav samples table.
+ * \return Number of prompts, 0 when the table is not in the bundle.
+ */
+size_t VoiceMsgTableSize(wav_samples_table_t table);
+/*!
+ * \brief Play every prompt of the tables one after another and check the
+ * playback timing, for a sink run without the speaker.
+ * \param tables Wav samples tables.
+ * \param tables_num Number of tables.
+ * \param max_start_us Start latency bound, queueing to the first sample.
+ * \return 0 when all prompts played with no underrun within the bound, -1
+ * otherwise.
+ */
+int VoiceMsgPlaybackCheck(const wav_samples_table_t *tables,
+                          size_t tables_num, int64_t max_start_us);
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_vfs_semihost.h"
+
+#include "AudioSink.hpp"
+#include "I2sTx.hpp"
+#include "Types.hpp"
+#include "dlog.h"
+
+static const char *TAG = "WavFileSink";
+
+#define WAV_FILE_MOUNT      "/host"
+#define WAV_FILE_HEADER_LEN 44
+// samples queued by a write which does not wait, as in the I2S DMA ring
+#define WAV_FILE_QUEUE_US ((I2S_TX_DMA_BUF_COUNT - 1) * I2S_TX_BLOCK_US)
+// longest underrun gap kept in the file
+#define WAV_FILE_MAX_GAP_LEN I2S_TX_SAMPLE_RATE
+
+static FILE *s_file = NULL;
+static uint32_t s_data_bytes = 0;
+/*! \brief Time the last queued sample finishes playing. */
+static int64_t s_play_end_us = 0;
+static bool s_idle = true;
+static size_t s_underruns = 0;
+
+static int64_t samples_to_us(size_t len) {
+  return len * 1000LL / I2S_TX_SAMPLE_KHZ;
+}
+
+static void put_u32(uint8_t *dst, uint32_t val) {
+  for (size_t i = 0; i < 4; i++) {
+    dst[i] = uint8_t(val >> (8 * i));
+  }
+}
+
+static void put_u16(uint8_t *dst, uint16_t val) {
+  dst[0] = uint8_t(val);
+  dst[1] = uint8_t(val >> 8);
+}
+
+/*! \brief Write RIFF header for the data written so far, keep position. */
+static void write_header() {
+  uint8_t header[WAV_FILE_HEADER_LEN];
+  memcpy(&header[0], "RIFF", 4);
+  put_u32(&header[4], WAV_FILE_HEADER_LEN - 8 + s_data_bytes);
+  memcpy(&header[8], "WAVEfmt ", 8);
+  put_u32(&header[16], 16);
+  put_u16(&header[20], WAV_FORMAT_PCM);
+  put_u16(&header[22], 1);
+  put_u32(&header[24], I2S_TX_SAMPLE_RATE);
+  put_u32(&header[28], I2S_TX_SAMPLE_RATE * sizeof(int16_t));
+  put_u16(&header[32], sizeof(int16_t));
+  put_u16(&header[34], 16);
+  memcpy(&header[36], "data", 4);
+  put_u32(&header[40], s_data_bytes);
+
+  const long pos = ftell(s_file);
+  fseek(s_file, 0, SEEK_SET);
+  fwrite(header, 1, sizeof(header), s_file);
+  fseek(s_file, pos, SEEK_SET);
+  fflush(s_file);
+}
+
+static void write_samples(const int16_t *data, size_t len) {
+  s_data_bytes += fwrite(data, sizeof(int16_t), len, s_file) * sizeof(int16_t);
+}
+
+static void write_silence(size_t len) {
+  static const int16_t zeros[64] = {};
+  while (len) {
+    const size_t n = std::min(len, sizeof(zeros) / sizeof(zeros[0]));
+    write_samples(zeros, n);
+    len -= n;
+  }
+}
+
+static int wav_file_init() {
+  if (esp_vfs_semihost_register(WAV_FILE_MOUNT, NULL) != ESP_OK) {
+    ESP_LOGE(TAG, "Unable to mount %s, is OpenOCD attached?", WAV_FILE_MOUNT);
+    return -1;
+  }
+  s_file = fopen(CONFIG_AUDIO_SINK_WAV_FILE_PATH, "wb");
+  if (s_file == NULL) {
+    ESP_LOGE(TAG, "Unable to create %s", CONFIG_AUDIO_SINK_WAV_FILE_PATH);
+    esp_vfs_semihost_unregister(WAV_FILE_MOUNT);
+    return -1;
+  }
+  s_data_bytes = 0;
+  fseek(s_file, WAV_FILE_HEADER_LEN, SEEK_SET);
+  write_header();
+  return 0;
+}
+
+static void wav_file_release() {
+  if (s_file) {
+    write_header();
+    fclose(s_file);
+    s_file = NULL;
+  }
+  esp_vfs_semihost_unregister(WAV_FILE_MOUNT);
+}
+
+static void wav_file_start() {
+  s_underruns = 0;
+  s_idle = true;
+}
+
+static void wav_file_stop() {
+  // the file is readable between sessions
+  write_header();
+}
+
+static int64_t wav_file_write(const int16_t *data, size_t len) {
+  int64_t now_us = esp_timer_get_time();
+  if (s_idle) {
+    s_play_end_us = now_us;
+  } else if (s_play_end_us < now_us) {
+    // the speaker would play silence until this block
+    const size_t gap = (now_us - s_play_end_us) * I2S_TX_SAMPLE_KHZ / 1000;
+    DLOGW(TAG, "underrun: gap us=%lld", now_us - s_play_end_us);
+    write_silence(std::min(gap, size_t(WAV_FILE_MAX_GAP_LEN)));
+    s_underruns++;
+    s_play_end_us = now_us;
+  }
+  s_idle = false;
+  // wait for a free buffer of the emulated DMA ring
+  const int64_t wait_us = s_play_end_us - now_us - WAV_FILE_QUEUE_US;
+  if (wait_us > 0) {
+    vTaskDelay(pdMS_TO_TICKS((wait_us + 999) / 1000));
+  }
+  const int64_t play_us = s_play_end_us;
+  s_play_end_us += samples_to_us(len);
+  write_samples(data, len);
+  return play_us;
+}
+
+static void wav_file_flush() {
+  // queued samples are never played, drop them from the file
+  const int64_t now_us = esp_timer_get_time();
+  if (s_play_end_us > now_us) {
+    const uint32_t drop = std::min(
+      s_data_bytes,
+      uint32_t((s_play_end_us - now_us) * I2S_TX_SAMPLE_KHZ / 1000) *
+        uint32_t(sizeof(int16_t)));
+    s_data_bytes -= drop;
+    fseek(s_file, WAV_FILE_HEADER_LEN + s_data_bytes, SEEK_SET);
+  }
+  s_play_end_us = now_us;
+}
+
+static size_t wav_file_underruns() {
+  return s_underruns;
+}
+
+const audio_sink_t wav_file_sink = {
+  .name = "wav file " CONFIG_AUDIO_SINK_WAV_FILE_PATH,
+  .init = wav_file_init,
+  .release = wav_file_release,
+  .start = wav_file_start,
+  .stop = wav_file_stop,
+  .write = wav_file_write,
+  .flush = wav_file_flush,
+  .underruns = wav_file_underruns,
+};
@@ -2,60 +2,119 @@
 
 #include "driver/gpio.h"
 
+#include "AudioSink.hpp"
 #include "I2sTx.hpp"
+#include "MemBudget.hpp"
+#include "Mixer.hpp"
+#include "Tasks.hpp"
 #include "Types.hpp"
 #include "WavPlayer.hpp"
+#include "alloc_track.h"
 #include "i2s_rx_slot.h"
 
 static const char *TAG = "WavPlayer";
 
+#define WAV_PLAYER_QUEUE_LEN 8
+
 static TaskHandle_t s_task_handle = NULL;
 EventGroupHandle_t xWavPlayerEventGroup;
 QueueHandle_t xWavPlayerQueue;
 
+static StaticQueue_t s_queue;
+static MEM_BUDGET(wav_player)
+  uint8_t s_queue_storage[WAV_PLAYER_QUEUE_LEN * sizeof(Sample_t)];
+static StaticEventGroup_t s_event_group;
+static MEM_BUDGET(wav_player) int16_t s_block[I2S_TX_SAMPLE_LEN];
+
+/*!
+ * \brief Hand playlist entries which may start now to the mixer.
+ * \return Queue time of the oldest started entry, -1 if none started.
+ */
+static int64_t start_entries() {
+  int64_t queued_us = -1;
+  Sample_t sample;
+  while (xQueuePeek(xWavPlayerQueue, &sample, 0) == pdPASS &&
+         mixer_can_start(sample)) {
+    xQueueReceive(xWavPlayerQueue, &sample, 0);
+    if (!sample.data) {
+      ESP_LOGE(TAG, "wav data is not allocated");
+    } else {
+      mixer_start(sample);
+      if (queued_us < 0 || sample.queued_us < queued_us) {
+        queued_us = sample.queued_us;
+      }
+    }
+  }
+  return queued_us;
+}
+
 static void wp_task(void *pvParameters) {
+  alloc_zone_enter("wav_player");
   for (;;) {
+    alloc_zone_check();
     Sample_t sample;
     xQueuePeek(xWavPlayerQueue, &sample, portMAX_DELAY);
-    if (xSemaphoreTake(xMicSema, portMAX_DELAY) == pdPASS) {
-      xEventGroupClearBits(xWavPlayerEventGroup, WAV_PLAYER_STOP_MSK);
-      while (xQueueReceive(xWavPlayerQueue, &sample, 100) == pdPASS) {
-        if (sample.data) {
-          i2s_play_wav(sample.data, sample.bytes);
-        } else {
-          ESP_LOGE(TAG, "wav data is not allocated");
+#if !CONFIG_KWS_AEC
+    // without echo cancellation KWS is deaf while a prompt plays
+    xSemaphoreTake(xMicSema, portMAX_DELAY);
+#endif
+    // entries queued after VoiceMsgStop are not aborted
+    xEventGroupClearBits(xWavPlayerEventGroup,
+                         WAV_PLAYER_STOP_MSK | WAV_PLAYER_ABORT_MSK);
+    audio_sink_start();
+    // one mixed DMA block per iteration
+    for (;;) {
+      const int64_t queued_us = start_entries();
+      if (xEventGroupGetBits(xWavPlayerEventGroup) & WAV_PLAYER_ABORT_MSK) {
+        mixer_reset();
+        audio_sink_flush();
+        break;
+      }
+      const size_t len = mixer_render(s_block, I2S_TX_SAMPLE_LEN);
+      if (len) {
+        const int64_t play_us = audio_sink_write(s_block, len);
+        // started entries begin with the block
+        if (queued_us >= 0) {
+          audio_sink_record_start(queued_us, play_us);
         }
+      } else if (xQueuePeek(xWavPlayerQueue, &sample, 100) != pdPASS) {
+        break;
       }
-      vTaskDelay(pdMS_TO_TICKS(500));
-      xSemaphoreGive(xMicSema);
-      xEventGroupSetBits(xWavPlayerEventGroup, WAV_PLAYER_STOP_MSK);
     }
+    audio_sink_stop();
+    mixer_log_stats();
+#if !CONFIG_KWS_AEC
+    // let the tail of the prompt leave the DMA buffers and the room
+    vTaskDelay(pdMS_TO_TICKS(500));
+    xSemaphoreGive(xMicSema);
+#endif
+    xEventGroupClearBits(xWavPlayerEventGroup, WAV_PLAYER_ABORT_MSK);
+    xEventGroupSetBits(xWavPlayerEventGroup, WAV_PLAYER_STOP_MSK);
   }
 }
 
 int initWavPlayer() {
-  ESP_LOGD(TAG, "Setting up i2s");
-  i2s_init();
+  ESP_LOGD(TAG, "Setting up audio sink");
+  if (audio_sink_init() < 0) {
+    return -1;
+  }
 
-  xWavPlayerQueue = xQueueCreate(100, sizeof(Sample_t));
+  xWavPlayerQueue = xQueueCreateStatic(WAV_PLAYER_QUEUE_LEN, sizeof(Sample_t),
+                                       s_queue_storage, &s_queue);
   if (xWavPlayerQueue == NULL) {
     ESP_LOGE(TAG, "Error creating wav queue");
     return -1;
   }
 
-  xWavPlayerEventGroup = xEventGroupCreate();
+  xWavPlayerEventGroup = xEventGroupCreateStatic(&s_event_group);
   if (xWavPlayerEventGroup == NULL) {
     ESP_LOGE(TAG, "Error creating xWavPlayerEventGroup");
     return -1;
   }
   xEventGroupSetBits(xWavPlayerEventGroup, WAV_PLAYER_STOP_MSK);
 
-  auto xReturned =
-    xTaskCreate(wp_task, "wp_task", configMINIMAL_STACK_SIZE + 1024, NULL, 3,
-                &s_task_handle);
-  if (xReturned != pdPASS) {
-    ESP_LOGE(TAG, "Error creating wp_task");
-    i2s_release();
+  if (createTask(eTask::WAV_PLAYER, wp_task, NULL, &s_task_handle) != pdPASS) {
+    audio_sink_release();
     return -1;
   }
   return 0;
@@ -64,10 +123,7 @@ int initWavPlayer() {
 void releaseWavPlayer() {
   xEventGroupWaitBits(xWavPlayerEventGroup, WAV_PLAYER_STOP_MSK, pdFALSE,
                       pdFALSE, portMAX_DELAY);
-  if (s_task_handle) {
-    vTaskDelete(s_task_handle);
-    s_task_handle = NULL;
-  }
+  deleteTask(eTask::WAV_PLAYER, &s_task_handle);
   if (xWavPlayerQueue) {
     vQueueDelete(xWavPlayerQueue);
     xWavPlayerQueue = NULL;
@@ -76,5 +132,5 @@ void releaseWavPlayer() {
     vEventGroupDelete(xWavPlayerEventGroup);
     xWavPlayerEventGroup = NULL;
   }
-  i2s_release();
+  audio_sink_release();
 }
@@ -10,10 +10,11 @@
 
 #define WAV_PLAYER_STOP_MSK  BIT0
 #define WAV_PLAYER_MUTED_MSK BIT1
+#define WAV_PLAYER_ABORT_MSK BIT2
 
 /*! \brief Global WavPlayer events. */
 extern EventGroupHandle_t xWavPlayerEventGroup;
-/*! \brief Global WavPlayer queue. */
+/*! \brief Global WavPlayer playlist, one entry per prompt. */
 extern QueueHandle_t xWavPlayerQueue;
 
 /*!
@@ -9,40 +9,46 @@
 
 #include "Lcd_GC9D01N.hpp"
 #include "ObjectsRecognition.h"
+#include "PronScore.h"
 #include "VoiceMsgPlayer.hpp"
-#include "bitmaps.h"
+#include "assets.h"
 #include "kws_event_task.h"
+#include "kws_latency.h"
 #include "kws_task.h"
 
 #define OBJECT_SWITCH_TIMEOUT_MS (size_t(1000) * 7)
 #define MAX_ATTEMPT_NUM          4
+#define PRON_SCORE_SHOW_MS       1000
+#define LABEL_SHOW_MS            1000
 
-extern const unsigned char *objects_model_ptr;
-extern const char *objects_labels[];
-extern unsigned int objects_labels_num;
-
-extern const unsigned char *numbers_model_ptr;
-extern const char *numbers_labels[];
-extern unsigned int numbers_labels_num;
-
-extern const unsigned char *g_ref_objects_samples[];
-extern unsigned int g_ref_objects_samples_num;
-
-extern const unsigned char *g_ref_numbers_samples[];
-extern unsigned int g_ref_numbers_samples_num;
-
-extern const unsigned char *g_voice_msg_samples[];
-extern unsigned int g_voice_msg_samples_num;
+static const char *s_objects_labels[] = {
+  "_silence_", "_unknown_", "cat", "dog", "car", "house",
+};
+static const char *s_numbers_labels[] = {
+  "_silence_", "_unknown_", "one", "two", "three",
+};
 
 static const struct wav_samples_table_t voice_msg_samples_table = {
-  .wav_samples = g_voice_msg_samples,
-  .samples_num = g_voice_msg_samples_num,
+  .name = "voice_msg",
 };
 
 static constexpr char TAG[] = "ObjectsRecognition";
 
 static nn_model_handle_t s_model_handle = NULL;
 
+#if CONFIG_KWS_UTTERANCE_REPLAY
+static kws_utterance_t s_utterance;
+static sample_stream_t s_utterance_stream = {
+  .read =
+    [](void *ctx, size_t pos, int16_t *dst, size_t len) {
+      return kws_utterance_read(static_cast<kws_utterance_t *>(ctx), pos,
+                                dst, len);
+    },
+  .ctx = &s_utterance,
+  .sample_rate = 0,
+};
+#endif
+
 static object_info_t objects_table[] = {
   {
     .label = "cat",
@@ -57,7 +63,7 @@ static object_info_t objects_table[] = {
         .type = object_info_t::IMAGE_BITMAP,
         .value =
           {
-            .image = cat_64_x_64_bits,
+            .image = "cat_64_x_64",
           },
       },
   },
@@ -74,7 +80,7 @@ static object_info_t objects_table[] = {
         .type = object_info_t::IMAGE_BITMAP,
         .value =
           {
-            .image = dog_64_x_64_bits,
+            .image = "dog_64_x_64",
           },
       },
   },
@@ -91,7 +97,7 @@ static object_info_t objects_table[] = {
         .type = object_info_t::IMAGE_BITMAP,
         .value =
           {
-            .image = car_64_x_64_bits,
+            .image = "car_64_x_64",
           },
       },
   },
@@ -108,7 +114,7 @@ static object_info_t objects_table[] = {
         .type = object_info_t::IMAGE_BITMAP,
         .value =
           {
-            .image = house_64_x_64_bits,
+            .image = "house_64_x_64",
           },
       },
   },
@@ -174,7 +180,8 @@ struct sub_scenario_desc_t {
   wav_samples_table_t ref_pronunciation;
   void (*transition_func)(App *app, const object_info_t *object_info);
   const float inference_threshold;
-  const unsigned char *model_ptr;
+  /*! \brief Model in the asset bundle. */
+  const char *model;
   const char **const labels;
   const unsigned int labels_num;
   const size_t mel_low_freq;
@@ -183,38 +190,30 @@ struct sub_scenario_desc_t {
   {
     .object_info_table = objects_table,
     .object_info_table_len = _countof(objects_table),
-    .ref_pronunciation =
-      {
-        .wav_samples = g_ref_objects_samples,
-        .samples_num = g_ref_objects_samples_num,
-      },
+    .ref_pronunciation = {.name = "ref_objects"},
     .transition_func =
       [](App *app, const object_info_t *object_info) {
         app->transition(new Objects(object_info));
       },
     .inference_threshold = OBJECTS_INFERENCE_THRESHOLD,
-    .model_ptr = objects_model_ptr,
-    .labels = objects_labels,
-    .labels_num = objects_labels_num,
+    .model = "objects",
+    .labels = s_objects_labels,
+    .labels_num = _countof(s_objects_labels),
     .mel_low_freq = 40,
     .mel_high_freq = 8000,
   },
   {
     .object_info_table = numbers_table,
     .object_info_table_len = _countof(numbers_table),
-    .ref_pronunciation =
-      {
-        .wav_samples = g_ref_numbers_samples,
-        .samples_num = g_ref_numbers_samples_num,
-      },
+    .ref_pronunciation = {.name = "ref_numbers"},
     .transition_func =
       [](App *app, const object_info_t *object_info) {
         app->transition(new Numbers(object_info));
       },
     .inference_threshold = NUMBERS_INFERENCE_THRESHOLD,
-    .model_ptr = numbers_model_ptr,
-    .labels = numbers_labels,
-    .labels_num = numbers_labels_num,
+    .model = "numbers",
+    .labels = s_numbers_labels,
+    .labels_num = _countof(s_numbers_labels),
     .mel_low_freq = 20,
     .mel_high_freq = 4000,
   },
@@ -223,25 +222,40 @@ static size_t s_objects_groups_len_arr[_countof(s_sub_scenario_descs) + 1] = {
   0};
 static size_t s_total_objects_num = 0;
 static size_t s_random_object_idx = size_t(-1);
+static size_t s_sub_scenario_idx = size_t(-1);
+static bool s_kws_running = false;
+/*! \brief KWS configuration in use, restored when a switch fails. */
+static kws_task_conf_t s_kws_conf = {};
 
-void initSubScenario(const sub_scenario_desc_t *desc);
+int initSubScenario(const sub_scenario_desc_t *desc);
 void releaseSubScenario();
 void switchSubScenario(App *app);
 
 void ObjectsRecognition::exitAction(App *app) {
   app->p_display->clear();
   app->p_display->send();
+#if !CONFIG_KWS_AEC
+  // KWS is muted while prompts play, the next object waits for them
   VoiceMsgWaitStop(portMAX_DELAY);
+#endif
 }
 void ObjectsRecognition::handleEvent(App *app, eEvent ev) {
   switch (ev) {
+  case eEvent::TIMEOUT:
+    if (view_ == VIEW_SCORE) {
+      end_attempt(app);
+      break;
+    } else if (view_ == VIEW_LABEL) {
+      show_object(app);
+      xTimerChangePeriod(xTimer, pdMS_TO_TICKS(OBJECT_SWITCH_TIMEOUT_MS), 0);
+      break;
+    }
+    // fall through
   case eEvent::TOUCH_CLICK:
   case eEvent::TOUCH_SWIPE_LEFT:
   case eEvent::TOUCH_SWIPE_RIGHT:
-  case eEvent::TIMEOUT:
     xTimerStop(xTimer, 0);
     kws_req_cancel();
-    releaseSubScenario();
     switchSubScenario(app);
     break;
   case eEvent::KWS_WORD:
@@ -252,32 +266,105 @@ void ObjectsRecognition::handleEvent(App *app, eEvent ev) {
     break;
   }
 }
+#if CONFIG_PRON_SCORE
+/*!
+ * \brief Score the recognized word against the reference pronunciation
+ * and show the score.
+ * \param grade Grade, left as is when the word is not scored.
+ * \return Score is on the display.
+ */
+static bool show_pron_score(App *app, const object_info_t *object_info,
+                            pron_grade_t *grade) {
+  const auto &ref_pron = object_info->ref_pronunciation;
+  size_t frames;
+  const float *features = kws_word_features(&frames);
+  pron_score_t score;
+  if (features == NULL ||
+      pron_score(ref_pron.samples_table->name, ref_pron.sample_idx, features,
+                 frames, &score) < 0) {
+    return false;
+  }
+  ESP_LOGI(TAG, "pronunciation of %s: score=%d, distance=%.2f",
+           object_info->label, score.score, score.distance);
+  app->p_display->clear();
+  app->p_display->print_string(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2, "%d%%",
+                               score.score);
+  app->p_display->send();
+  *grade = score.grade;
+  return true;
+}
+#endif
+
 void ObjectsRecognition::check_kws_result(App *app) {
   int category;
   if (xQueueReceive(xKWSResultQueue, &category, pdMS_TO_TICKS(10)) == pdPASS) {
+    kws_latency_mark(KWS_LAT_EVENT);
+    // barge-in: the answer cuts the prompt still playing
+    VoiceMsgStop();
+    pron_grade_t grade = PRON_GRADE_GOOD;
+#if CONFIG_PRON_SCORE
+    if (show_pron_score(app, object_info_, &grade)) {
+      view_ = VIEW_SCORE;
+    }
+#endif
     if (category == object_info_->real_label_idx) {
-      VoiceMsgPlay(voice_msg_samples_table, 1);
+      if (grade == PRON_GRADE_GOOD) {
+        VoiceMsgPlay(voice_msg_samples_table, 1);
+      }
       xEventGroupSetBits(xStatusEventGroup, STATUS_EVENT_GOOD_MSK);
-      releaseSubScenario();
-      switchSubScenario(app);
+      result_ = ATTEMPT_PASSED;
     } else {
       xEventGroupSetBits(xStatusEventGroup, STATUS_EVENT_BAD_MSK);
-      if (attempt_num_++ >= (MAX_ATTEMPT_NUM - 1)) {
-        reset_attempt(app);
-      } else {
-        kws_req_word(1);
-        xTimerChangePeriod(xTimer, pdMS_TO_TICKS(OBJECT_SWITCH_TIMEOUT_MS), 0);
-      }
+      result_ = grade == PRON_GRADE_POOR ||
+                    attempt_num_++ >= (MAX_ATTEMPT_NUM - 1)
+                  ? ATTEMPT_FAILED
+                  : ATTEMPT_RETRY;
+    }
+    if (view_ == VIEW_SCORE) {
+      xTimerChangePeriod(xTimer, pdMS_TO_TICKS(PRON_SCORE_SHOW_MS), 0);
+    } else {
+      end_attempt(app);
     }
   } else {
     ESP_LOGW(TAG, "Unable to receive KWS word");
   }
 }
+void ObjectsRecognition::end_attempt(App *app) {
+  const bool redraw = view_ != VIEW_OBJECT;
+  view_ = VIEW_OBJECT;
+  switch (result_) {
+  case ATTEMPT_PASSED:
+    switchSubScenario(app);
+    break;
+  case ATTEMPT_FAILED:
+    reset_attempt(app);
+    break;
+  case ATTEMPT_RETRY:
+    if (redraw) {
+      show_object(app);
+    }
+    kws_req_word(1);
+    xTimerChangePeriod(xTimer, pdMS_TO_TICKS(OBJECT_SWITCH_TIMEOUT_MS), 0);
+    break;
+  }
+}
+void ObjectsRecognition::show_object(App *app) {
+  app->p_display->clear();
+  draw(app);
+  app->p_display->send();
+}
 void ObjectsRecognition::reset_attempt(App *app) {
   attempt_num_ = 0;
   assert(object_info_);
   const auto &ref_pron = object_info_->ref_pronunciation;
   assert(ref_pron.samples_table);
+#if CONFIG_KWS_UTTERANCE_REPLAY
+  // you said ..., should be ...; the next word releases the stream
+  if (kws_utterance_get(&s_utterance) == 0) {
+    s_utterance_stream.sample_rate = s_utterance.sample_rate;
+    VoiceMsgPlayStream(&s_utterance_stream);
+  }
+#endif
   VoiceMsgPlay(*ref_pron.samples_table, ref_pron.sample_idx);
   ESP_LOGI(TAG, "label=%s", object_info_->label);
 
@@ -286,27 +373,45 @@ void ObjectsRecognition::reset_attempt(App *app) {
                                object_info_->label);
   app->p_display->send();
 
-  vTaskDelay(pdMS_TO_TICKS(1000));
+#if CONFIG_KWS_AEC
+  // the answer may come over the reference and cuts it
+  view_ = VIEW_LABEL;
+  kws_req_word(1);
+  xTimerChangePeriod(xTimer, pdMS_TO_TICKS(LABEL_SHOW_MS), 0);
+#else
+  vTaskDelay(pdMS_TO_TICKS(LABEL_SHOW_MS));
   app->transition(clone());
+#endif
+}
+
+void Objects::draw(App *app) {
+  asset_t image;
+  if (assets_find(object_info_->data.value.image, ASSET_BITMAP, &image) == 0) {
+    app->p_display->draw(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2, 64, 64,
+                         static_cast<const uint8_t *>(image.data));
+  }
 }
 
 void Objects::enterAction(App *app) {
   assert(object_info_);
   assert(object_info_->data.type == object_info_t::IMAGE_BITMAP);
   ESP_LOGI(TAG, "Object: %s", object_info_->label);
-  app->p_display->draw(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2, 64, 64,
-                       object_info_->data.value.image);
+  draw(app);
   app->p_display->send();
   kws_req_word(1);
   xTimerChangePeriod(xTimer, pdMS_TO_TICKS(OBJECT_SWITCH_TIMEOUT_MS), 0);
 }
 
+void Numbers::draw(App *app) {
+  app->p_display->print_string(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2, "%s",
+                               object_info_->data.value.str);
+}
+
 void Numbers::enterAction(App *app) {
   assert(object_info_);
   assert(object_info_->data.type == object_info_t::STRING);
   ESP_LOGI(TAG, "Say number %s", object_info_->data.value.str);
-  app->p_display->print_string(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2, "%s",
-                               object_info_->data.value.str);
+  draw(app);
   app->p_display->send();
   kws_req_word(1);
   xTimerChangePeriod(xTimer, pdMS_TO_TICKS(OBJECT_SWITCH_TIMEOUT_MS), 0);
@@ -334,28 +439,61 @@ void switchSubScenario(App *app) {
            s_random_object_idx, object_idx, idx);
 
   const auto &desc = s_sub_scenario_descs[idx];
-  int errors = nn_model_init(&s_model_handle,
-                             nn_model_config_t{
-                               .model_ptr = desc.model_ptr,
-                               .labels = desc.labels,
-                               .labels_num = desc.labels_num,
-                               .is_quantized = true,
-                               .inference_threshold = desc.inference_threshold,
-                             }) < 0;
-  errors += kws_task_init(kws_task_conf_t{
-              .model_handle = s_model_handle,
-              .mic_gain = 30,
-              .ns_level = 2,
-              .mel_low_freq = desc.mel_low_freq,
-              .mel_high_freq = desc.mel_high_freq,
-            }) < 0;
-  errors += kws_event_task_init();
-  if (errors) {
-    ESP_LOGE(TAG, "KWS model init error");
-    app->transition(nullptr);
+  // KWS engine keeps running, the model is swapped only between groups
+  if (idx != s_sub_scenario_idx) {
+    if (initSubScenario(&desc) < 0) {
+      ESP_LOGE(TAG, "KWS model init error");
+      app->transition(nullptr);
+      return;
+    }
+    s_sub_scenario_idx = idx;
+  }
+  desc.transition_func(app, &desc.object_info_table[object_idx]);
+}
+
+int initSubScenario(const sub_scenario_desc_t *desc) {
+  asset_t model;
+  if (assets_find(desc->model, ASSET_MODEL, &model) < 0) {
+    return -1;
+  }
+  // the old model keeps serving until the new one is swapped in
+  nn_model_handle_t model_handle = NULL;
+  if (nn_model_init(&model_handle,
+                    nn_model_config_t{
+                      .model_ptr =
+                        static_cast<const unsigned char *>(model.data),
+                      .labels = desc->labels,
+                      .labels_num = desc->labels_num,
+                      .is_quantized = true,
+                      .inference_threshold = desc->inference_threshold,
+                    }) < 0) {
+    return -1;
+  }
+  const kws_task_conf_t conf = {
+    .model_handle = model_handle,
+    .mic_gain = 30,
+    .ns_level = 2,
+    .mel_low_freq = desc->mel_low_freq,
+    .mel_high_freq = desc->mel_high_freq,
+  };
+  int errors = 0;
+  if (s_kws_running) {
+    if (kws_task_reconfigure(conf) < 0) {
+      kws_task_reconfigure(s_kws_conf);
+      nn_model_release(model_handle);
+      return -1;
+    }
   } else {
-    desc.transition_func(app, &desc.object_info_table[object_idx]);
+    errors += kws_task_init(conf) < 0;
+    errors += kws_event_task_init() < 0;
+    s_kws_running = true;
+  }
+  if (s_model_handle) {
+    nn_model_release(s_model_handle);
   }
+  s_model_handle = model_handle;
+  s_kws_conf = conf;
+  return errors ? -1 : 0;
 }
 
 void initScenario(App *app) {
@@ -391,12 +529,31 @@ void initScenario(App *app) {
   }
   ESP_LOGD(TAG, "total_objects_num=%u", s_total_objects_num);
 
+#if CONFIG_VOICE_MSG_PLAYBACK_CHECK
+  const wav_samples_table_t tables[] = {
+    voice_msg_samples_table,
+    s_sub_scenario_descs[0].ref_pronunciation,
+    s_sub_scenario_descs[1].ref_pronunciation,
+  };
+  if (VoiceMsgPlaybackCheck(tables, _countof(tables),
+                            CONFIG_VOICE_MSG_PLAYBACK_CHECK_START_MS *
+                              1000LL) < 0) {
+    // debug option, a failed check must not go unnoticed
+    ESP_LOGE(TAG, "Prompt playback check failed");
+    abort();
+  }
+#endif
+
   switchSubScenario(app);
 }
 
 void releaseSubScenario() {
-  kws_event_task_release();
-  kws_task_release();
+  if (s_kws_running) {
+    kws_event_task_release();
+    kws_task_release();
+    s_kws_running = false;
+  }
+  s_sub_scenario_idx = size_t(-1);
   if (s_model_handle) {
     nn_model_release(s_model_handle);
     s_model_handle = NULL;
@@ -405,6 +562,8 @@ void releaseSubScenario() {
 
 void releaseScenario(App *app) {
   ESP_LOGI(TAG, "Exit Objects Recongnition scenario");
+  // a replayed word is streamed from the KWS capture ring
+  VoiceMsgWaitStop(portMAX_DELAY);
   releaseSubScenario();
 
   bootloader_random_disable();
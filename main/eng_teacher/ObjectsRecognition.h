@@ -31,7 +31,8 @@ struct object_info_t {
   struct {
     object_data_t type;
     union {
-      const unsigned char *image;
+      /*! \brief Bitmap in the asset bundle. */
+      const char *image;
       const char *str;
       size_t sample_idx;
       int number;
@@ -41,15 +42,34 @@ struct object_info_t {
 
 struct ObjectsRecognition : State {
   ObjectsRecognition(const object_info_t *const object_info)
-    : attempt_num_(0), object_info_(object_info) {}
+    : attempt_num_(0), result_(ATTEMPT_RETRY), view_(VIEW_OBJECT),
+      object_info_(object_info) {}
   void enterAction(App *app) override = 0;
   void exitAction(App *app) override final;
   void handleEvent(App *app, eEvent ev) override final;
 
 protected:
+  enum attempt_result_t {
+    ATTEMPT_PASSED,
+    ATTEMPT_RETRY,
+    ATTEMPT_FAILED,
+  };
   size_t attempt_num_;
+  /*! \brief What replaced the object on the display until TIMEOUT. */
+  enum view_t {
+    VIEW_OBJECT,
+    /*! \brief result_ is taken on TIMEOUT. */
+    VIEW_SCORE,
+    VIEW_LABEL,
+  };
+  attempt_result_t result_;
+  view_t view_;
   virtual void check_kws_result(App *app);
   virtual void reset_attempt(App *app);
+  void end_attempt(App *app);
+  void show_object(App *app);
+  /*! \brief Draw the object, the caller sends the display. */
+  virtual void draw(App *app) = 0;
   const object_info_t *const object_info_;
 };
 
@@ -57,12 +77,18 @@ struct Objects : ObjectsRecognition {
   using ObjectsRecognition::ObjectsRecognition;
   State *clone() override final { return new Objects(*this); }
   void enterAction(App *app) override final;
+
+protected:
+  void draw(App *app) override final;
 };
 
 struct Numbers : ObjectsRecognition {
   using ObjectsRecognition::ObjectsRecognition;
   State *clone() override final { return new Numbers(*this); }
   void enterAction(App *app) override final;
+
+protected:
+  void draw(App *app) override final;
 };
 
 #endif // _OBJECTS_RECOGNITION_H_
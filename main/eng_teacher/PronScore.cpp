@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "MemBudget.hpp"
+#include "PronScore.h"
+#include "assets.h"
+#include "dlog.h"
+
+static const char *TAG = "PronScore";
+
+// frames this far below the loudest one are silence, about 30 dB
+#define PRON_TRIM_C0 30.0f
+// distances of score 100 and 0, set on the reference prompts played with
+// time stretch and noise against each other
+#define PRON_DIST_BEST  5.0f
+#define PRON_DIST_WORST 13.0f
+#define PRON_GOOD_SCORE  60
+#define PRON_CLOSE_SCORE 30
+
+static_assert(sizeof(pron_ref_header_t) == 4 + 4 * PRON_REF_COEFFS,
+              "pron_ref_header_t is packed by tools/pack_assets.py");
+static_assert(sizeof(pron_ref_entry_t) == 8,
+              "pron_ref_entry_t is packed by tools/pack_assets.py");
+
+/*! \brief Trimmed word frames, mean removed. */
+static MEM_BUDGET(eng_teacher) float s_word[KWS_FRAME_NUM][PRON_REF_COEFFS];
+
+/*!
+ * \brief Trim silence at both ends of the word and remove the mean.
+ * \return Number of frames in s_word.
+ */
+static size_t load_word(const float *features, size_t frames) {
+  float top = -INFINITY;
+  for (size_t f = 0; f < frames; f++) {
+    top = std::max(top, features[f * KWS_NUM_MFCC]);
+  }
+  size_t first = 0;
+  size_t last = frames;
+  while (features[first * KWS_NUM_MFCC] < top - PRON_TRIM_C0) {
+    first++;
+  }
+  while (features[(last - 1) * KWS_NUM_MFCC] < top - PRON_TRIM_C0) {
+    last--;
+  }
+  const size_t n = last - first;
+  for (size_t k = 0; k < PRON_REF_COEFFS; k++) {
+    float mean = 0;
+    for (size_t f = first; f < last; f++) {
+      mean += features[f * KWS_NUM_MFCC + k + 1];
+    }
+    mean /= n;
+    for (size_t f = 0; f < n; f++) {
+      s_word[f][k] = features[(first + f) * KWS_NUM_MFCC + k + 1] - mean;
+    }
+  }
+  return n;
+}
+
+/*!
+ * \brief Symmetric DTW of s_word and the reference, L1 frame distance.
+ * \return Distance normalized by the path length.
+ */
+static float dtw(size_t n, const int8_t *ref, size_t m, const float *scales) {
+  float rows[2][KWS_FRAME_NUM + 1];
+  float *prev = rows[0];
+  float *cur = rows[1];
+  prev[0] = 0;
+  std::fill(&prev[1], &prev[m + 1], INFINITY);
+  for (size_t i = 1; i <= n; i++) {
+    cur[0] = INFINITY;
+    for (size_t j = 1; j <= m; j++) {
+      const int8_t *r = &ref[(j - 1) * PRON_REF_COEFFS];
+      float d = 0;
+      for (size_t k = 0; k < PRON_REF_COEFFS; k++) {
+        d += fabsf(s_word[i - 1][k] - r[k] * scales[k]);
+      }
+      cur[j] = std::min({prev[j] + d, cur[j - 1] + d, prev[j - 1] + 2 * d});
+    }
+    std::swap(prev, cur);
+  }
+  return prev[m] / (n + m);
+}
+
+int pron_score(const char *table, size_t id, const float *features,
+               size_t frames, pron_score_t *score) {
+  if (frames == 0 || frames > KWS_FRAME_NUM) {
+    return -1;
+  }
+  char name[ASSETS_NAME_LEN];
+  snprintf(name, sizeof(name), "%s.mfcc", table);
+  asset_t asset;
+  if (assets_find(name, ASSET_MFCC, &asset) < 0) {
+    return -1;
+  }
+  const auto *base = static_cast<const uint8_t *>(asset.data);
+  const auto *header = static_cast<const pron_ref_header_t *>(asset.data);
+  const auto *entries =
+    reinterpret_cast<const pron_ref_entry_t *>(base + sizeof(*header));
+  if (asset.size < sizeof(*header) || header->coeffs != PRON_REF_COEFFS ||
+      asset.size < sizeof(*header) + header->prompts * sizeof(*entries) ||
+      id == 0 || id > header->prompts) {
+    ESP_LOGE(TAG, "%s: no reference of prompt %u", name, id);
+    return -1;
+  }
+  const auto &entry = entries[id - 1];
+  if (entry.frames == 0 || entry.frames > KWS_FRAME_NUM ||
+      entry.offset + entry.frames * PRON_REF_COEFFS > asset.size) {
+    ESP_LOGE(TAG, "%s: malformed reference of prompt %u", name, id);
+    return -1;
+  }
+
+  const int64_t t1 = esp_timer_get_time();
+  const size_t n = load_word(features, frames);
+  score->distance =
+    dtw(n, reinterpret_cast<const int8_t *>(base + entry.offset),
+        entry.frames, header->scales);
+  const float scaled = (PRON_DIST_WORST - score->distance) /
+                       (PRON_DIST_WORST - PRON_DIST_BEST);
+  score->score = lroundf(std::min(std::max(scaled, 0.f), 1.f) * 100);
+  score->grade = score->score >= PRON_GOOD_SCORE    ? PRON_GRADE_GOOD
+                 : score->score >= PRON_CLOSE_SCORE ? PRON_GRADE_CLOSE
+                                                    : PRON_GRADE_POOR;
+  DLOGD(TAG, "%s/%u: frames=%u/%u, distance=%.2f, %lld us", table, id, n,
+        entry.frames, score->distance, esp_timer_get_time() - t1);
+  return 0;
+}
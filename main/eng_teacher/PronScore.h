@@ -0,0 +1,58 @@
+#ifndef _PRON_SCORE_H_
+#define _PRON_SCORE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "kws_task.h"
+
+/*! \brief Reference coefficients per frame, c0 only trims silence. */
+#define PRON_REF_COEFFS (KWS_NUM_MFCC - 1)
+
+/*!
+ * \brief Header of a "<table>.mfcc" asset written by tools/pack_assets.py,
+ * followed by an entry per prompt of the table.
+ */
+struct pron_ref_header_t {
+  uint16_t prompts;
+  uint16_t coeffs;
+  /*! \brief Dequantization scale per coefficient. */
+  float scales[PRON_REF_COEFFS];
+};
+
+/*! \brief Reference frames of a prompt, int8 PRON_REF_COEFFS each. */
+struct pron_ref_entry_t {
+  /*! \brief Offset from the asset start. */
+  uint32_t offset;
+  uint16_t frames;
+  uint16_t reserved;
+};
+
+enum pron_grade_t {
+  PRON_GRADE_POOR,
+  PRON_GRADE_CLOSE,
+  PRON_GRADE_GOOD,
+};
+
+struct pron_score_t {
+  /*! \brief Frame distance averaged along the DTW path. */
+  float distance;
+  /*! \brief 0 to 100. */
+  int score;
+  pron_grade_t grade;
+};
+
+/*!
+ * \brief Score word against the reference pronunciation of a prompt by DTW
+ * of their MFCC frames. Silence is trimmed and the mean removed from both.
+ * \param table Prompt table name, the reference is "<table>.mfcc".
+ * \param id Prompt id, starts at 1.
+ * \param features Word MFCC frames, KWS_NUM_MFCC coefficients each.
+ * \param frames Number of frames, up to KWS_FRAME_NUM.
+ * \param score Result.
+ * \return 0 on success, -1 when the reference is missing or malformed.
+ */
+int pron_score(const char *table, size_t id, const float *features,
+               size_t frames, pron_score_t *score);
+
+#endif // _PRON_SCORE_H_
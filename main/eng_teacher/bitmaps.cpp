@@ -1,4 +1,3 @@
-#include "bitmaps.h"
 
 const unsigned char cat_64_x_64_bits[] = {
   0xf8, 0x07, 0x00, 0x00, 0x00, 0x00, 0xe0, 0x1f, 0xfc, 0x3f, 0x00, 0x00, 0x00,
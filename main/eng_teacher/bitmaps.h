@@ -1,9 +0,0 @@
-#ifndef _BITMAPS_H_
-#define _BITMAPS_H_
-
-extern const unsigned char cat_64_x_64_bits[];
-extern const unsigned char dog_64_x_64_bits[];
-extern const unsigned char car_64_x_64_bits[];
-extern const unsigned char house_64_x_64_bits[];
-
-#endif // _BITMAPS_H_
@@ -3962,13 +3962,3 @@ const unsigned char numbers_ds_cnn_quantized_tflite[] = {
   0x0c, 0x00, 0x0c, 0x00, 0x0b, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00,
   0x0c, 0x00, 0x00, 0x00, 0x16, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x16
 };
-unsigned int numbers_ds_cnn_quantized_tflite_len = 47544;
-const char *numbers_labels[] = {
-  "_silence_",
-  "_unknown_",
-  "one",
-  "two",
-  "three",
-};
-unsigned int numbers_labels_num = 5;
-const unsigned char *numbers_model_ptr = numbers_ds_cnn_quantized_tflite;
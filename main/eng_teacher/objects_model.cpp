@@ -3968,14 +3968,3 @@ const unsigned char objects_ds_cnn_quantized_tflite[] = {
   0x00, 0x00, 0x04, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x16, 0x00, 0x00, 0x00,
   0x00, 0x00, 0x00, 0x16
 };
-unsigned int objects_ds_cnn_quantized_tflite_len = 47608;
-const char *objects_labels[] = {
-  "_silence_",
-  "_unknown_",
-  "cat",
-  "dog",
-  "car",
-  "house",
-};
-unsigned int objects_labels_num = 6;
-const unsigned char *objects_model_ptr = objects_ds_cnn_quantized_tflite;
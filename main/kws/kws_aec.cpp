@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+#include "MemBudget.hpp"
+#include "kws_aec.h"
+
+static const char *TAG = "kws_aec";
+
+// Reference is written when the block enters the TX DMA queue, up to
+// 400 ms before it is played, and read up to the filter length behind.
+#define AEC_REF_RING_LEN 8192 // 512 ms, power of two
+#define AEC_TAPS         (KWS_AEC_SAMPLE_RATE / 1000 * CONFIG_KWS_AEC_TAIL_MS)
+// Reference is read ahead of the estimated play time, the filter absorbs
+// playback which starts up to AEC_LEAD samples earlier than estimated.
+#define AEC_LEAD       (AEC_TAPS / 4)
+#define AEC_WINDOW_LEN (KWS_AEC_MAX_FRAME_LEN + AEC_TAPS - 1)
+
+#define AEC_MU              0.5f
+#define AEC_REF_FLOOR       64 // mean square, about -54 dBFS
+#define AEC_CONVERGED       30 // adapted frames
+#define AEC_DTD_RATIO       4  // residual to echo estimate energy
+#define AEC_DTD_HOLD_FRAMES 10
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static MEM_BUDGET(kws) int16_t s_ref[AEC_REF_RING_LEN];
+/*! \brief Sample index following the last written reference sample. */
+static int64_t s_ref_end = 0;
+
+static MEM_BUDGET(kws) float s_taps[AEC_TAPS];
+static MEM_BUDGET(kws) float s_window[AEC_WINDOW_LEN];
+static MEM_BUDGET(kws) float s_residual[KWS_AEC_MAX_FRAME_LEN];
+static size_t s_adapted = 0;
+static size_t s_dtd_hold = 0;
+
+struct kws_aec_stats_t {
+  size_t frames;
+  size_t adapted;
+  size_t double_talk;
+  double mic_energy;
+  double residual_energy;
+} static s_stats;
+
+static int64_t us_to_idx(int64_t us) {
+  return us * KWS_AEC_SAMPLE_RATE / 1000000;
+}
+
+static int64_t ref_end() {
+  portENTER_CRITICAL(&s_lock);
+  const int64_t end = s_ref_end;
+  portEXIT_CRITICAL(&s_lock);
+  return end;
+}
+
+static void ref_publish(int64_t end) {
+  portENTER_CRITICAL(&s_lock);
+  s_ref_end = end;
+  portEXIT_CRITICAL(&s_lock);
+}
+
+void kws_aec_ref_write(const int16_t *data, size_t len, int64_t play_us) {
+  const int64_t start = us_to_idx(play_us);
+  const int64_t end = ref_end();
+  // silence between prompts, older samples are out of reach anyway
+  for (int64_t k = std::max(end, start - AEC_REF_RING_LEN); k < start; k++) {
+    s_ref[k & (AEC_REF_RING_LEN - 1)] = 0;
+  }
+  // single writer, the reader only sees samples before the published end
+  for (size_t i = 0; i < len; i++) {
+    s_ref[(start + i) & (AEC_REF_RING_LEN - 1)] = data[i];
+  }
+  ref_publish(start + len);
+}
+
+void kws_aec_ref_cancel(int64_t from_us) {
+  const int64_t from = us_to_idx(from_us);
+  portENTER_CRITICAL(&s_lock);
+  s_ref_end = std::min(s_ref_end, from);
+  portEXIT_CRITICAL(&s_lock);
+}
+
+/*!
+ * \brief Copy reference samples [from, from + len) to s_window, samples not
+ * written yet or already overwritten read as zero.
+ * \return Mean square of the window.
+ */
+static float read_window(int64_t from, size_t len) {
+  const int64_t end = ref_end();
+  const int64_t begin = end - AEC_REF_RING_LEN;
+  if (from >= end || from + int64_t(len) <= begin) {
+    return 0.f;
+  }
+  float energy = 0.f;
+  for (size_t i = 0; i < len; i++) {
+    const int64_t k = from + i;
+    const float val =
+      k >= begin && k < end ? s_ref[k & (AEC_REF_RING_LEN - 1)] : 0.f;
+    s_window[i] = val;
+    energy += val * val;
+  }
+  return energy / len;
+}
+
+static float dot(const float *a, const float *b, size_t len) {
+  float acc = 0.f;
+  for (size_t i = 0; i < len; i++) {
+    acc += a[i] * b[i];
+  }
+  return acc;
+}
+
+bool kws_aec_process(int16_t *data, size_t len, int64_t end_us) {
+  len = std::min(len, size_t(KWS_AEC_MAX_FRAME_LEN));
+  const size_t window_len = len + AEC_TAPS - 1;
+  const int64_t from = us_to_idx(end_us) + AEC_LEAD - int64_t(window_len);
+  const float ref_energy = read_window(from, window_len);
+  if (ref_energy < AEC_REF_FLOOR) {
+    return false;
+  }
+  s_stats.frames++;
+
+  // block NLMS: filter the frame with fixed taps, then one update
+  float echo_energy = 0.f;
+  float residual_energy = 0.f;
+  float mic_energy = 0.f;
+  for (size_t n = 0; n < len; n++) {
+    const float echo = dot(s_taps, &s_window[n], AEC_TAPS);
+    const float mic = data[n];
+    const float residual = mic - echo;
+    s_residual[n] = residual;
+    echo_energy += echo * echo;
+    residual_energy += residual * residual;
+    mic_energy += mic * mic;
+    data[n] = int16_t(std::max(std::min(residual, 32767.f), -32768.f));
+  }
+
+  // near end speech shows up as residual the echo estimate does not explain,
+  // a filter which has not converged explains nothing yet
+  if (s_adapted >= AEC_CONVERGED &&
+      residual_energy > AEC_DTD_RATIO * echo_energy) {
+    s_dtd_hold = AEC_DTD_HOLD_FRAMES;
+  }
+  if (s_dtd_hold) {
+    s_dtd_hold--;
+    s_stats.double_talk++;
+    return true;
+  }
+
+  const float step = AEC_MU / (ref_energy * (AEC_TAPS + len) + 1.f);
+  for (size_t i = 0; i < AEC_TAPS; i++) {
+    s_taps[i] += step * dot(s_residual, &s_window[i], len);
+  }
+  s_adapted++;
+  s_stats.adapted++;
+  if (s_adapted >= AEC_CONVERGED) {
+    s_stats.mic_energy += mic_energy;
+    s_stats.residual_energy += residual_energy;
+  }
+  return true;
+}
+
+void kws_aec_reset() {
+  memset(s_taps, 0, sizeof(s_taps));
+  s_adapted = 0;
+  s_dtd_hold = 0;
+  s_stats = kws_aec_stats_t{};
+}
+
+void kws_aec_log_stats() {
+  const float erle_db =
+    s_stats.residual_energy > 0.
+      ? 10.f * log10f(s_stats.mic_energy / s_stats.residual_energy)
+      : 0.f;
+  ESP_LOGI(TAG, "frames=%u, adapted=%u, double talk=%u, ERLE=%.1f dB",
+           s_stats.frames, s_stats.adapted, s_stats.double_talk, erle_db);
+}
@@ -0,0 +1,55 @@
+#ifndef _KWS_AEC_H_
+#define _KWS_AEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*! \brief Sample rate of both the playback reference and the microphone. */
+#define KWS_AEC_SAMPLE_RATE   16000
+#define KWS_AEC_MAX_FRAME_LEN 320
+
+#if CONFIG_KWS_AEC
+/*!
+ * \brief Store played samples as echo reference, called by the I2S TX path.
+ * \param data Samples as written to I2S, volume applied.
+ * \param len Number of samples.
+ * \param play_us Estimated time the first sample reaches the speaker.
+ */
+void kws_aec_ref_write(const int16_t *data, size_t len, int64_t play_us);
+/*!
+ * \brief Forget reference from the given time on, its DMA buffers were
+ * silenced.
+ * \param from_us Time of the first dropped sample.
+ */
+void kws_aec_ref_cancel(int64_t from_us);
+/*!
+ * \brief Remove playback echo from a microphone frame in place. Frames with
+ * no reference around them are left untouched.
+ * \param data Microphone samples at KWS_AEC_SAMPLE_RATE.
+ * \param len Number of samples, up to KWS_AEC_MAX_FRAME_LEN.
+ * \param end_us Capture time of the sample following the frame.
+ * \return Echo was cancelled.
+ */
+bool kws_aec_process(int16_t *data, size_t len, int64_t end_us);
+/*!
+ * \brief Clear adapted echo path.
+ */
+void kws_aec_reset();
+/*!
+ * \brief Log processed frames, double talk and echo return loss
+ * enhancement.
+ */
+void kws_aec_log_stats();
+#else
+static inline void kws_aec_ref_write(const int16_t *data, size_t len,
+                                     int64_t play_us) {}
+static inline void kws_aec_ref_cancel(int64_t from_us) {}
+static inline bool kws_aec_process(int16_t *data, size_t len,
+                                   int64_t end_us) {
+  return false;
+}
+static inline void kws_aec_reset() {}
+static inline void kws_aec_log_stats() {}
+#endif
+
+#endif // _KWS_AEC_H_
@@ -1,4 +1,5 @@
 #include "Event.hpp"
+#include "Tasks.hpp"
 
 #include "kws_event_task.h"
 #include "kws_task.h"
@@ -18,11 +19,8 @@ static void kws_event_task(void *pv) {
 }
 
 int kws_event_task_init() {
-  auto xReturned = xTaskCreate(kws_event_task, "kws_event_task",
-                               configMINIMAL_STACK_SIZE + 1024, NULL,
-                               tskIDLE_PRIORITY, &s_task_handle);
-  if (xReturned != pdPASS) {
-    ESP_LOGE(TAG, "Error creating KWS event task");
+  if (createTask(eTask::KWS_EVENT, kws_event_task, NULL, &s_task_handle) !=
+      pdPASS) {
     return -1;
   }
 
@@ -30,8 +28,5 @@ int kws_event_task_init() {
 }
 
 void kws_event_task_release() {
-  if (s_task_handle) {
-    vTaskDelete(s_task_handle);
-    s_task_handle = NULL;
-  }
+  deleteTask(eTask::KWS_EVENT, &s_task_handle);
 }
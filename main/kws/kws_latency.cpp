@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cstring>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include "kws_latency.h"
+
+static const char *TAG = "kws_latency";
+
+#define LAT_WORDS_NUM        8
+#define LAT_SUB_BUCKETS_LOG2 3
+#define LAT_SUB_BUCKETS      (1 << LAT_SUB_BUCKETS_LOG2)
+#define LAT_MIN_US_LOG2      8
+#define LAT_OCTAVES          12
+#define LAT_BUCKETS_NUM      (LAT_OCTAVES * LAT_SUB_BUCKETS)
+
+/*! \brief Log-linear histogram, 8 buckets per octave from 256 us to ~1 s. */
+struct latency_hist_t {
+  uint16_t counts[LAT_BUCKETS_NUM];
+  uint32_t total;
+  int64_t max_us;
+
+  static size_t bucket(int64_t us) {
+    if (us < (1 << LAT_MIN_US_LOG2)) {
+      return 0;
+    }
+    const uint32_t val = uint32_t(std::min(us, int64_t(INT32_MAX)));
+    const int octave = 31 - __builtin_clz(val);
+    const size_t idx =
+      (octave - LAT_MIN_US_LOG2) * LAT_SUB_BUCKETS +
+      ((val >> (octave - LAT_SUB_BUCKETS_LOG2)) & (LAT_SUB_BUCKETS - 1));
+    return std::min(idx, size_t(LAT_BUCKETS_NUM - 1));
+  }
+  static int64_t bucket_upper_us(size_t idx) {
+    const int octave = idx / LAT_SUB_BUCKETS + LAT_MIN_US_LOG2;
+    const int64_t sub = idx % LAT_SUB_BUCKETS;
+    return (LAT_SUB_BUCKETS + sub + 1) << (octave - LAT_SUB_BUCKETS_LOG2);
+  }
+  void add(int64_t us) {
+    uint16_t &cnt = counts[bucket(us)];
+    if (cnt < UINT16_MAX) {
+      cnt++;
+    }
+    total++;
+    max_us = std::max(max_us, us);
+  }
+  /*! \brief Upper bound of the percentile bucket, within 1/8 octave. */
+  int64_t percentile_us(uint32_t pct) const {
+    const uint32_t target = (total * pct + 99) / 100;
+    uint32_t acc = 0;
+    for (size_t i = 0; i < LAT_BUCKETS_NUM; i++) {
+      acc += counts[i];
+      if (acc >= target) {
+        return std::min(bucket_upper_us(i), max_us);
+      }
+    }
+    return max_us;
+  }
+};
+
+struct latency_interval_t {
+  const char *name;
+  kws_latency_stage_t from;
+  kws_latency_stage_t to;
+};
+
+static const latency_interval_t s_intervals[] = {
+  {"hangover", KWS_LAT_SPEECH_END, KWS_LAT_VAD_END},
+  {"features", KWS_LAT_VAD_END, KWS_LAT_FEATURES},
+  {"inference", KWS_LAT_FEATURES, KWS_LAT_INFERENCE},
+  {"delivery", KWS_LAT_INFERENCE, KWS_LAT_EVENT},
+  {"action", KWS_LAT_EVENT, KWS_LAT_ACTION},
+  {"speech->event", KWS_LAT_SPEECH_END, KWS_LAT_EVENT},
+  {"speech->action", KWS_LAT_SPEECH_END, KWS_LAT_ACTION},
+};
+#define LAT_INTERVALS_NUM (sizeof(s_intervals) / sizeof(s_intervals[0]))
+#define LAT_SLO_INTERVAL  (LAT_INTERVALS_NUM - 1)
+
+struct word_record_t {
+  int64_t stamps[KWS_LAT_STAGES_NUM];
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static word_record_t s_words[LAT_WORDS_NUM];
+static size_t s_head = 0;
+static latency_hist_t s_hists[LAT_INTERVALS_NUM];
+static uint32_t s_slo_violations = 0;
+static uint32_t s_events = 0;
+
+static word_record_t *find_record(kws_latency_stage_t stage) {
+  if (stage == KWS_LAT_VAD_START) {
+    word_record_t *rec = &s_words[s_head];
+    s_head = (s_head + 1) % LAT_WORDS_NUM;
+    memset(rec, 0, sizeof(word_record_t));
+    return rec;
+  }
+  for (size_t i = 0; i < LAT_WORDS_NUM; i++) {
+    if (stage == KWS_LAT_ACTION) {
+      // newest handled word
+      word_record_t *rec =
+        &s_words[(s_head + LAT_WORDS_NUM - 1 - i) % LAT_WORDS_NUM];
+      if (rec->stamps[KWS_LAT_EVENT] && !rec->stamps[KWS_LAT_ACTION]) {
+        return rec;
+      }
+    } else {
+      // oldest word waiting for the stage, the pipeline keeps word order
+      word_record_t *rec = &s_words[(s_head + i) % LAT_WORDS_NUM];
+      if (rec->stamps[stage - 1] && !rec->stamps[stage]) {
+        return rec;
+      }
+    }
+  }
+  return NULL;
+}
+
+void kws_latency_mark(kws_latency_stage_t stage, int64_t time_us) {
+  if (time_us == 0) {
+    time_us = esp_timer_get_time();
+  }
+  int64_t slo_us = -1;
+  bool dump = false;
+
+  portENTER_CRITICAL(&s_lock);
+  word_record_t *rec = find_record(stage);
+  if (rec) {
+    rec->stamps[stage] = time_us;
+    for (size_t i = 0; i < LAT_INTERVALS_NUM; i++) {
+      const auto &interval = s_intervals[i];
+      if (interval.to == stage && rec->stamps[interval.from]) {
+        const int64_t us = time_us - rec->stamps[interval.from];
+        s_hists[i].add(us);
+        if (i == LAT_SLO_INTERVAL && us > CONFIG_KWS_LATENCY_SLO_MS * 1000) {
+          s_slo_violations++;
+          slo_us = us;
+        }
+      }
+    }
+    if (stage == KWS_LAT_EVENT) {
+      s_events++;
+      dump = CONFIG_KWS_LATENCY_DUMP_PERIOD > 0 &&
+             s_events % CONFIG_KWS_LATENCY_DUMP_PERIOD == 0;
+    }
+  }
+  portEXIT_CRITICAL(&s_lock);
+
+  if (slo_us >= 0) {
+    ESP_LOGW(TAG, "SLO violated: speech->action=%lld ms (%d ms)",
+             slo_us / 1000, CONFIG_KWS_LATENCY_SLO_MS);
+  }
+  if (dump) {
+    kws_latency_dump();
+  }
+}
+
+void kws_latency_drop_pending() {
+  portENTER_CRITICAL(&s_lock);
+  for (auto &rec : s_words) {
+    if (!rec.stamps[KWS_LAT_INFERENCE]) {
+      memset(&rec, 0, sizeof(word_record_t));
+    }
+  }
+  portEXIT_CRITICAL(&s_lock);
+}
+
+void kws_latency_dump() {
+  struct {
+    uint32_t n;
+    int64_t p50, p95, p99, max;
+  } res[LAT_INTERVALS_NUM];
+
+  portENTER_CRITICAL(&s_lock);
+  for (size_t i = 0; i < LAT_INTERVALS_NUM; i++) {
+    const auto &hist = s_hists[i];
+    res[i].n = hist.total;
+    res[i].p50 = hist.percentile_us(50);
+    res[i].p95 = hist.percentile_us(95);
+    res[i].p99 = hist.percentile_us(99);
+    res[i].max = hist.max_us;
+  }
+  const uint32_t slo_violations = s_slo_violations;
+  portEXIT_CRITICAL(&s_lock);
+
+  ESP_LOGI(TAG, "%-15s %6s %8s %8s %8s %8s", "interval, ms", "n", "p50",
+           "p95", "p99", "max");
+  for (size_t i = 0; i < LAT_INTERVALS_NUM; i++) {
+    ESP_LOGI(TAG, "%-15s %6u %8.1f %8.1f %8.1f %8.1f", s_intervals[i].name,
+             res[i].n, res[i].p50 / 1000.f, res[i].p95 / 1000.f,
+             res[i].p99 / 1000.f, res[i].max / 1000.f);
+  }
+  ESP_LOGI(TAG, "SLO speech->action <= %d ms: %u of %u violated",
+           CONFIG_KWS_LATENCY_SLO_MS, slo_violations,
+           res[LAT_SLO_INTERVAL].n);
+}
+
+void kws_latency_reset() {
+  portENTER_CRITICAL(&s_lock);
+  memset(s_words, 0, sizeof(s_words));
+  memset(s_hists, 0, sizeof(s_hists));
+  s_head = 0;
+  s_slo_violations = 0;
+  s_events = 0;
+  portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,50 @@
+#ifndef _KWS_LATENCY_H_
+#define _KWS_LATENCY_H_
+
+#include <stdint.h>
+
+/*! \brief Pipeline points of a word, in order. */
+enum kws_latency_stage_t {
+  KWS_LAT_VAD_START = 0,
+  /*! \brief Last voiced frame of the word. */
+  KWS_LAT_SPEECH_END,
+  /*! \brief VAD closed the word, hangover after speech end. */
+  KWS_LAT_VAD_END,
+  KWS_LAT_FEATURES,
+  KWS_LAT_INFERENCE,
+  /*! \brief KWS_WORD event handled by the current App state. */
+  KWS_LAT_EVENT,
+  /*! \brief Output GPIO toggled because of the word. */
+  KWS_LAT_ACTION,
+  KWS_LAT_STAGES_NUM,
+};
+
+#if CONFIG_KWS_LATENCY_STATS
+/*!
+ * \brief Record pipeline point of the oldest word waiting for it, VAD start
+ * opens a new word. Action goes to the latest handled word.
+ * \param stage Pipeline point.
+ * \param time_us Timestamp, esp_timer_get_time() if 0.
+ */
+void kws_latency_mark(kws_latency_stage_t stage, int64_t time_us = 0);
+/*!
+ * \brief Forget words which did not reach inference, e.g. cancelled request.
+ */
+void kws_latency_drop_pending();
+/*!
+ * \brief Log latency percentiles and SLO violations.
+ */
+void kws_latency_dump();
+/*!
+ * \brief Clear collected histograms.
+ */
+void kws_latency_reset();
+#else
+static inline void kws_latency_mark(kws_latency_stage_t stage,
+                                    int64_t time_us = 0) {}
+static inline void kws_latency_drop_pending() {}
+static inline void kws_latency_dump() {}
+static inline void kws_latency_reset() {}
+#endif
+
+#endif // _KWS_LATENCY_H_
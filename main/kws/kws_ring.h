@@ -0,0 +1,247 @@
+#ifndef _KWS_RING_H_
+#define _KWS_RING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "stddef.h"
+
+/*! \brief Rolling window of MFCC frames. */
+template <size_t FRAMES, size_t COEFFS> struct mfcc_ring {
+private:
+  float data_[FRAMES * COEFFS];
+  size_t max_abs_[FRAMES];
+  size_t head_;
+  size_t size_;
+
+public:
+  mfcc_ring() { reset(); }
+
+  /*!
+   * \brief Claim next frame slot, overwriting the oldest one when full.
+   * \param max_abs Max abs value of the frame audio.
+   * \return Pointer to COEFFS floats to fill.
+   */
+  float *push(size_t max_abs) {
+    float *slot = &data_[head_ * COEFFS];
+    max_abs_[head_] = max_abs;
+    head_ = (head_ + 1) % FRAMES;
+    size_ = std::min(size_ + 1, FRAMES);
+    return slot;
+  }
+  /*!
+   * \brief Copy frames to contiguous buffer, oldest first.
+   * \param dst Buffer of size() * COEFFS floats.
+   */
+  void linearize(float *dst) const {
+    const size_t tail = (head_ + FRAMES - size_) % FRAMES;
+    const size_t first = std::min(size_, FRAMES - tail);
+    memcpy(dst, &data_[tail * COEFFS], first * COEFFS * sizeof(float));
+    memcpy(&dst[first * COEFFS], data_,
+           (size_ - first) * COEFFS * sizeof(float));
+  }
+  /*! \brief Max abs value over stored frames. */
+  size_t max_abs() const {
+    size_t res = 0;
+    for (size_t i = 0; i < size_; i++) {
+      res = std::max(res, max_abs_[(head_ + FRAMES - 1 - i) % FRAMES]);
+    }
+    return res;
+  }
+  size_t size() const { return size_; }
+  bool full() const { return size_ == FRAMES; }
+  void reset() {
+    head_ = 0;
+    size_ = 0;
+  }
+};
+
+/*!
+ * \brief Single producer, single consumer ring of audio frames addressed by
+ * sequence number. The producer fills the head slot in place and publishes
+ * it, consumers read frames directly without copying them out.
+ *
+ * Frames of one span, e.g. the last word, can outlive their slot: when the
+ * producer recycles a slot of the span, the slot buffer is swapped with one
+ * of RETAIN spare buffers instead of being overwritten. The span is
+ * released when the next one starts.
+ */
+template <typename T, size_t FRAMES, size_t MAX_FRAME_LEN, size_t RETAIN = 0>
+struct frame_ring {
+private:
+  T data_[(FRAMES + RETAIN) * MAX_FRAME_LEN];
+  std::atomic<T *> slots_[FRAMES];
+  /*! \brief Retained buffers in sequence order, then the spare ones. */
+  T *pool_[RETAIN + 1];
+  size_t frame_len_;
+  std::atomic<size_t> head_;
+  /*! \brief Retained span, end is SIZE_MAX while it is open. */
+  std::atomic<size_t> span_start_;
+  std::atomic<size_t> span_end_;
+  std::atomic<size_t> retained_;
+  /*! \brief Odd while the span changes, readers check it after copying. */
+  std::atomic<size_t> gen_;
+
+  /*! \brief Keep the frame the head slot held if it belongs to the span. */
+  void recycle(size_t head) {
+    const size_t n = retained_.load(std::memory_order_relaxed);
+    if (head < FRAMES || n == RETAIN) {
+      return;
+    }
+    const size_t seq = head - FRAMES;
+    if (seq != span_start_.load(std::memory_order_relaxed) + n ||
+        seq >= span_end_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    auto &slot = slots_[head % FRAMES];
+    T *spare = pool_[n];
+    pool_[n] = slot.load(std::memory_order_relaxed);
+    slot.store(spare, std::memory_order_release);
+    retained_.store(n + 1, std::memory_order_release);
+  }
+
+  void set_span(size_t start, size_t end) {
+    gen_.fetch_add(1, std::memory_order_acq_rel);
+    retained_.store(0, std::memory_order_relaxed);
+    span_start_.store(start, std::memory_order_relaxed);
+    span_end_.store(end, std::memory_order_relaxed);
+    gen_.fetch_add(1, std::memory_order_release);
+  }
+
+public:
+  frame_ring()
+    : frame_len_(MAX_FRAME_LEN), head_(0), span_start_(0), span_end_(0),
+      retained_(0), gen_(0) {
+    for (size_t i = 0; i < FRAMES; i++) {
+      slots_[i].store(&data_[i * MAX_FRAME_LEN], std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < RETAIN; i++) {
+      pool_[i] = &data_[(FRAMES + i) * MAX_FRAME_LEN];
+    }
+  }
+
+  /*! \brief Frame slot by sequence number. */
+  T *frame(size_t seq) {
+    return slots_[seq % FRAMES].load(std::memory_order_acquire);
+  }
+  /*! \brief Publish the head slot, producer only. */
+  void publish() {
+    const size_t head = head_.load(std::memory_order_relaxed) + 1;
+    // the next slot is swapped while its frame is still readable
+    recycle(head);
+    head_.store(head, std::memory_order_release);
+  }
+  /*! \brief Sequence number of the slot being filled. */
+  size_t head() const { return head_.load(std::memory_order_acquire); }
+  /*! \brief Oldest frame not overwritten yet. */
+  size_t tail() const {
+    const size_t head = this->head();
+    return head >= FRAMES - 1 ? head - (FRAMES - 1) : 0;
+  }
+  size_t frame_len() const { return frame_len_; }
+  void reset(size_t frame_len) {
+    set_span(0, 0);
+    frame_len_ = std::min(frame_len, MAX_FRAME_LEN);
+    head_.store(0, std::memory_order_release);
+  }
+  /*!
+   * \brief Start retaining frames from seq on, up to RETAIN of them past
+   * the ring. Releases the previous span, producer only.
+   */
+  void retain(size_t seq) { set_span(seq, SIZE_MAX); }
+  /*! \brief Close the span before seq, producer only. */
+  void retain_end(size_t seq) {
+    span_end_.store(seq, std::memory_order_release);
+  }
+  /*!
+   * \brief Get the closed span, any thread.
+   * \param gen Span generation, to read frames.
+   * \return There is a closed span.
+   */
+  bool span(size_t *gen, size_t *start, size_t *end) const {
+    *gen = gen_.load(std::memory_order_acquire);
+    *start = span_start_.load(std::memory_order_acquire);
+    *end = span_end_.load(std::memory_order_acquire);
+    return !(*gen & 1) && *gen == gen_.load(std::memory_order_acquire) &&
+           *end != SIZE_MAX && *end > *start;
+  }
+  /*!
+   * \brief Copy part of a span frame, from the retained buffers or the
+   * ring, any thread.
+   * \return Copy is valid, false once the frame is gone or the span of gen
+   * is released.
+   */
+  bool read_span(size_t gen, size_t seq, size_t offset, T *dst, size_t len) {
+    const size_t k = seq - span_start_.load(std::memory_order_acquire);
+    const T *src = NULL;
+    if (k < retained_.load(std::memory_order_acquire)) {
+      src = pool_[k];
+    } else if (!(seq < tail())) {
+      src = frame(seq);
+    } else {
+      return false;
+    }
+    memcpy(dst, &src[offset], len * sizeof(T));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (gen_.load(std::memory_order_relaxed) != gen) {
+      return false;
+    }
+    // a frame recycled during the copy is intact if it was retained
+    return !(seq < tail()) || k < retained_.load(std::memory_order_acquire);
+  }
+};
+
+/*! \brief Moving average of class posteriors. */
+template <size_t CLASSES, size_t MAX_WINDOW> struct posterior_smoother {
+private:
+  float history_[MAX_WINDOW][CLASSES];
+  float sum_[CLASSES];
+  float avg_[CLASSES];
+  size_t window_;
+  size_t head_;
+  size_t size_;
+
+public:
+  posterior_smoother() : window_(1) { reset(); }
+
+  /*!
+   * \brief Add posteriors and get smoothed ones.
+   * \param scores Class posteriors.
+   * \param len Number of classes.
+   * \return Smoothed posteriors.
+   */
+  const float *push(const float *scores, size_t len) {
+    len = std::min(len, CLASSES);
+    if (size_ == window_) {
+      for (size_t i = 0; i < len; i++) {
+        sum_[i] -= history_[head_][i];
+      }
+    } else {
+      size_++;
+    }
+    for (size_t i = 0; i < len; i++) {
+      history_[head_][i] = scores[i];
+      sum_[i] += scores[i];
+      avg_[i] = sum_[i] / size_;
+    }
+    head_ = (head_ + 1) % window_;
+    return avg_;
+  }
+  /*!
+   * \brief Clear history.
+   * \param window New window len, 0 keeps current.
+   */
+  void reset(size_t window = 0) {
+    if (window) {
+      window_ = std::min(window, MAX_WINDOW);
+    }
+    memset(sum_, 0, sizeof(sum_));
+    memset(avg_, 0, sizeof(avg_));
+    head_ = 0;
+    size_ = 0;
+  }
+};
+
+#endif // _KWS_RING_H_
@@ -1,17 +1,26 @@
+#include <climits>
+
 #include "esp_agc.h"
 #include "esp_log.h"
 #include "esp_ns.h"
 #include "esp_timer.h"
 #include "esp_vad.h"
 
+#include "MemBudget.hpp"
+#include "Tasks.hpp"
+#include "alloc_track.h"
+#include "dlog.h"
 #include "audio_preprocessor.h"
 #include "i2s_rx_slot.h"
+#include "kws_aec.h"
+#include "kws_latency.h"
+#include "kws_ring.h"
 #include "kws_task.h"
+#include "mic_proc.h"
 
 static const char *TAG = "kws_task";
 
 QueueHandle_t xWordQueue = NULL;
-StreamBufferHandle_t xWordFramesBuffer = NULL;
 SemaphoreHandle_t xKWSSema = NULL;
 QueueHandle_t xKWSRequestQueue = NULL;
 QueueHandle_t xKWSResultQueue = NULL;
@@ -19,38 +28,237 @@ EventGroupHandle_t xKWSEventGroup = NULL;
 
 static TaskHandle_t xVADTaskHandle = NULL;
 static TaskHandle_t xKWSTaskHandle = NULL;
+static TaskHandle_t xKWSInferTaskHandle = NULL;
+static QueueHandle_t xKWSFeatureQueue = NULL;
+static SemaphoreHandle_t xKWSInferFlushSema = NULL;
 
 struct kws_task_param_t {
   nn_model_handle_t model_handle = NULL;
+  nn_model_handle_t screen_model_handle = NULL;
   AudioPreprocessor *pp = NULL;
+  kws_continuous_conf_t continuous = {};
 } static s_kws_task_params;
 
+struct kws_frontend_t {
+  size_t decim = 1;
+  size_t sample_rate = CONFIG_MIC_SAMPLE_RATE;
+  size_t frame_len = MIC_FRAME_LEN;
+  size_t frame_sz = MIC_FRAME_SZ;
+} static s_frontend;
+
+struct kws_cascade_stats_t {
+  size_t words = 0;
+  size_t rejected = 0;
+  int64_t screen_us = 0;
+  int64_t verify_us = 0;
+} static s_cascade_stats;
+
+static kws_task_conf_t s_conf = {};
+static kws_task_conf_t s_pending_conf = {};
+static int s_reconf_res = 0;
+
 static void *s_agc_handle = NULL;
 static ns_handle_t s_ns_handle = NULL;
 static vad_handle_t s_vad_handle = NULL;
 
+// kws_vad_conf_t defaults
 #define DET_VOICED_FRAMES_WINDOW      16
 #define DET_VOICED_FRAMES_THRESHOLD   8
 #define DET_UNVOICED_FRAMES_THRESHOLD 2
+#define DET_PREROLL_FRAMES            DET_VOICED_FRAMES_WINDOW
+
+#define VAD_HISTORY_LEN (2 * KWS_MAX_VAD_WINDOW)
 
 #define KWS_FRAME_SZ          (KWS_FRAME_LEN * MIC_ELEM_BYTES)
 #define KWS_FRAME_SHIFT_BYTES (KWS_FRAME_SHIFT * MIC_ELEM_BYTES)
-#define MFCC_BUF_SZ           (KWS_FRAME_NUM * KWS_NUM_MFCC * sizeof(float))
-#define MFCC_PROC_FRAME_NUM   (KWS_FRAME_SHIFT / MIC_FRAME_LEN)
 
 #define PROC_BUF_SZ        KWS_FRAME_SZ
 #define PROC_BUF_FRAME_NUM (PROC_BUF_SZ / MIC_FRAME_SZ)
 
 #define AGC_FRAME_LEN_MS 10
-#define AGC_FRAME_LEN    (CONFIG_MIC_SAMPLE_RATE / 1000 * AGC_FRAME_LEN_MS)
+
+#define KWS_DECIM_FACTOR 2
+#define KWS_DECIM_TAPS   48
+
+#define GATE_OPEN_RATIO      4
+#define GATE_ZCR_RATIO       2
+#define GATE_ZCR_Q8          77 // 0.3 crossings per sample
+#define GATE_HANGOVER_FRAMES 30
+
+// kws_task notification bits, wake-up hints only: the request queue holds the
+// actual request state.
+#define KWS_NTF_DATA_MSK   BIT0
+#define KWS_NTF_CANCEL_MSK BIT1
+
+#define KWS_FEATURE_QUEUE_SZ 2
+
+// i2s_rx_slot_read which waited for DMA got the newest frame
+#define MIC_READ_WAIT_US 1000
+
+#if CONFIG_KWS_AEC
+static_assert(CONFIG_MIC_SAMPLE_RATE == KWS_AEC_SAMPLE_RATE,
+              "echo canceller runs at the playback rate");
+static_assert(MIC_FRAME_LEN <= KWS_AEC_MAX_FRAME_LEN, "mic frame too long");
+#endif
 
 static const float silence_mfcc_coeffs[KWS_NUM_MFCC] = {
   -247.13936,    8.881784e-16,   2.220446e-14,   -1.0658141e-14,
   8.881784e-16,  -1.5987212e-14, 1.15463195e-14, -4.440892e-15,
   1.0658141e-14, -4.7961635e-14};
 
-static audio_t current_frames[DET_VOICED_FRAMES_WINDOW * MIC_FRAME_LEN] = {0};
-static raw_audio_t raw_data_buffer[MIC_FRAME_LEN] = {0};
+// Anti-alias lowpass for the half-rate front end: Kaiser windowed sinc,
+// fc = 3650 Hz at 16 kHz, -45 dB at 4300 Hz.
+static const int16_t decim_coeffs[KWS_DECIM_TAPS] = {
+  2,     5,     -7,    -19,   11,    49,    -4,    -100,  -31,   172,
+  116,   -250,  -279,  308,   549,   -296,  -962,  134,   1584,  342,
+  -2645, -1719, 5743,  13681, 13681, 5743,  -1719, -2645, 342,   1584,
+  134,   -962,  -296,  549,   308,   -279,  -250,  116,   172,   -31,
+  -100,  -4,    49,    11,    -19,   -7,    5,     2};
+
+static polyphase_decimator_2<KWS_DECIM_TAPS> s_decimator(decim_coeffs);
+
+static energy_gate s_gate(GATE_OPEN_RATIO, GATE_ZCR_RATIO, GATE_ZCR_Q8,
+                          GATE_HANGOVER_FRAMES);
+
+struct kws_stage_stats_t {
+  int64_t convert_us;
+  int64_t agc_us;
+  int64_t ns_us;
+  int64_t vad_us;
+  int64_t aec_us;
+  size_t aec_frames;
+  size_t frames;
+  size_t open_frames;
+} static s_stats;
+
+struct frame_stats_t {
+  uint32_t energy;
+  uint32_t zcr_q8;
+  size_t max_abs;
+};
+
+/*! \brief Word features passed from kws_task to kws_infer_task. */
+struct kws_feature_block_t {
+  /*! \brief Barrier, acked once all previous blocks are served. */
+  bool flush;
+  /*! \brief MFCC frames of the word, silence pads the rest. */
+  size_t frames;
+  float features[KWS_FEATURES_LEN];
+};
+
+static MEM_BUDGET(kws) kws_feature_block_t s_word_block;
+static MEM_BUDGET(kws) kws_feature_block_t s_infer_block;
+#if CONFIG_PRON_SCORE
+/*! \brief Last recognized word, see kws_word_features. */
+static MEM_BUDGET(kws) kws_feature_block_t s_last_word;
+#endif
+
+static MEM_BUDGET(kws) mfcc_ring<KWS_FRAME_NUM, KWS_NUM_MFCC> s_mfcc_ring;
+static posterior_smoother<KWS_MAX_LABELS, KWS_MAX_SMOOTH_WINDOW> s_smoother;
+
+/*! \brief Storage of a statically allocated queue. */
+template <size_t LEN, size_t ITEM_SZ> struct static_queue_t {
+  StaticQueue_t queue;
+  uint8_t storage[LEN * ITEM_SZ];
+
+  QueueHandle_t create() {
+    return xQueueCreateStatic(LEN, ITEM_SZ, storage, &queue);
+  }
+};
+
+static static_queue_t<MAX_WORDS * 2, sizeof(WordDesc_t)> s_word_queue;
+static MEM_BUDGET(kws)
+  static_queue_t<KWS_FEATURE_QUEUE_SZ, sizeof(kws_feature_block_t)>
+    s_feature_queue;
+static static_queue_t<MAX_WORDS, sizeof(int)> s_result_queue;
+static static_queue_t<1, sizeof(size_t)> s_request_queue;
+static StaticSemaphore_t s_kws_sema;
+static StaticSemaphore_t s_infer_flush_sema;
+static StaticEventGroup_t s_kws_event_group;
+
+static size_t compute_max_abs(audio_t *data, size_t len) {
+  size_t max_abs = 0;
+  for (size_t j = 0; j < len; j++) {
+    const size_t abs_val = abs(data[j]);
+    if (abs_val > max_abs) {
+      max_abs = abs_val;
+    }
+  }
+  return max_abs;
+}
+
+/*!
+ * \brief Incremental MFCC extraction into s_mfcc_ring. Audio arrives in
+ * frame shift chunks, each chunk completes the window started by the
+ * previous one.
+ */
+struct mfcc_stream_t {
+  uint8_t buf[PROC_BUF_SZ];
+  size_t shift_bytes;
+  size_t filled;
+  size_t chunks;
+  size_t prev_max_abs;
+
+  void reset(size_t shift) {
+    memset(buf, 0, sizeof(buf));
+    shift_bytes = shift;
+    filled = 0;
+    chunks = 0;
+    prev_max_abs = 0;
+    s_mfcc_ring.reset();
+  }
+  /*! \brief Free space of the pending chunk. */
+  uint8_t *tail() { return &buf[shift_bytes + filled]; }
+  size_t tail_len() const { return shift_bytes - filled; }
+  /*! \brief Total bytes received since reset. */
+  size_t bytes() const { return chunks * shift_bytes + filled; }
+  /*!
+   * \brief Account received bytes, compute frame when chunk is complete.
+   * \return New frame was pushed.
+   */
+  bool commit(AudioPreprocessor *pp, size_t bytes) {
+    filled += bytes;
+    if (filled < shift_bytes) {
+      return false;
+    }
+    filled = 0;
+    audio_t *chunk = (audio_t *)&buf[shift_bytes];
+    const size_t max_abs = compute_max_abs(chunk, shift_bytes / MIC_ELEM_BYTES);
+    const bool pushed = chunks > 0;
+    if (pushed) {
+      pp->MfccCompute((audio_t *)buf,
+                      s_mfcc_ring.push(std::max(prev_max_abs, max_abs)), 1);
+    }
+    memmove(buf, chunk, shift_bytes);
+    prev_max_abs = max_abs;
+    chunks++;
+    return pushed;
+  }
+  /*! \brief Zero pad partial chunk and close the last window. */
+  void flush(AudioPreprocessor *pp) {
+    if (filled) {
+      memset(tail(), 0, tail_len());
+      commit(pp, tail_len());
+    }
+    if (chunks) {
+      memset(&buf[shift_bytes], 0, shift_bytes);
+      pp->MfccCompute((audio_t *)buf, s_mfcc_ring.push(prev_max_abs), 1);
+    }
+  }
+} static MEM_BUDGET(kws) s_mfcc_stream;
+
+#if CONFIG_KWS_UTTERANCE_REPLAY
+// the last word keeps this many frames past the capture ring
+#define KWS_RETAIN_FRAMES (CONFIG_KWS_UTTERANCE_REPLAY_MS / MIC_FRAME_LEN_MS)
+#else
+#define KWS_RETAIN_FRAMES 0
+#endif
+
+static MEM_BUDGET(kws) frame_ring<audio_t, KWS_CAPTURE_FRAMES, MIC_FRAME_LEN,
+                                  KWS_RETAIN_FRAMES> s_capture;
+static kws_vad_conf_t s_vad_conf = {};
+static MEM_BUDGET(kws) raw_audio_t raw_data_buffer[MIC_FRAME_LEN];
+static MEM_BUDGET(kws) audio_t full_rate_frame[MIC_FRAME_LEN];
 
 static void vad_start() {
   xSemaphoreTake(xMicSema, portMAX_DELAY);
@@ -64,213 +272,678 @@ static void vad_stop() {
   xSemaphoreGive(xMicSema);
 }
 
-static size_t compute_max_abs(audio_t *data, size_t len) {
+static void notify_kws(uint32_t bits) {
+  if (xKWSTaskHandle) {
+    xTaskNotify(xKWSTaskHandle, bits, eSetBits);
+  }
+}
+
+/*! \brief Sleep until vad_task sends data or request is cancelled. */
+static void wait_kws_event() {
+  xTaskNotifyWait(0, ULONG_MAX, NULL, portMAX_DELAY);
+}
+
+static void log_stats() {
+  const size_t frames = std::max(s_stats.frames, size_t(1));
+  ESP_LOGI(TAG,
+           "frames=%u, gate open=%u%%, us/frame: convert=%lld, agc=%lld, "
+           "ns=%lld, vad=%lld",
+           s_stats.frames, s_stats.open_frames * 100 / frames,
+           s_stats.convert_us / frames, s_stats.agc_us / frames,
+           s_stats.ns_us / frames, s_stats.vad_us / frames);
+#if CONFIG_KWS_AEC
+  ESP_LOGI(TAG, "aec frames=%u, us/frame=%lld", s_stats.aec_frames,
+           s_stats.aec_us / std::max(s_stats.aec_frames, size_t(1)));
+  kws_aec_log_stats();
+#endif
+}
+
+static void log_cascade_stats() {
+  const auto &stats = s_cascade_stats;
+  if (stats.words == 0) {
+    return;
+  }
+  const size_t verified = std::max(stats.words - stats.rejected, size_t(1));
+  ESP_LOGI(TAG,
+           "cascade: words=%u, second stage avoided=%u (%u%%), us/word: "
+           "screen=%lld, verify=%lld",
+           stats.words, stats.rejected, stats.rejected * 100 / stats.words,
+           stats.screen_us / stats.words, stats.verify_us / verified);
+}
+
+static void convert_frame(audio_t *dst, const raw_audio_t *src, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    dst[i] = audio_t(src[i] >> 16);
+  }
+}
+
+static frame_stats_t analyze_frame(const audio_t *data, size_t len) {
+  int64_t energy = 0;
+  size_t zc = 0;
   size_t max_abs = 0;
-  for (size_t j = 0; j < len; j++) {
-    const size_t abs_val = abs(data[j]);
+  audio_t prev = 0;
+  for (size_t i = 0; i < len; i++) {
+    const audio_t val = data[i];
+    energy += int32_t(val) * val;
+    zc += (val ^ prev) < 0;
+    prev = val;
+    const size_t abs_val = abs(val);
     if (abs_val > max_abs) {
       max_abs = abs_val;
     }
   }
-  return max_abs;
+  return frame_stats_t{
+    .energy = uint32_t(energy / len),
+    .zcr_q8 = uint32_t((zc << 8) / len),
+    .max_abs = max_abs,
+  };
+}
+
+/*!
+ * \brief Capture time of the end of the frame just read. A read which
+ * waited for DMA got the newest frame, frames read without waiting were
+ * queued and follow the previous one.
+ */
+static int64_t mic_frame_end(int64_t prev_end_us, int64_t read_us,
+                             int64_t done_us) {
+  if (done_us - read_us > MIC_READ_WAIT_US) {
+    return done_us;
+  }
+  return std::min(prev_end_us + MIC_FRAME_LEN_MS * 1000, done_us);
+}
+
+static void vad_configure(const kws_vad_conf_t &conf) {
+  if (conf.onset_window == 0) {
+    s_vad_conf = kws_vad_conf_t{
+      .onset_window = DET_VOICED_FRAMES_WINDOW,
+      .onset_voiced = DET_VOICED_FRAMES_THRESHOLD,
+      .offset_window = DET_VOICED_FRAMES_WINDOW,
+      .offset_voiced = DET_UNVOICED_FRAMES_THRESHOLD,
+      .preroll_frames = DET_PREROLL_FRAMES,
+    };
+  } else {
+    auto &vad = s_vad_conf;
+    vad.onset_window = std::min(conf.onset_window, size_t(KWS_MAX_VAD_WINDOW));
+    vad.onset_voiced =
+      std::max(std::min(conf.onset_voiced, vad.onset_window), size_t(1));
+    vad.offset_window =
+      std::max(std::min(conf.offset_window, size_t(KWS_MAX_VAD_WINDOW)),
+               size_t(1));
+    vad.offset_voiced = std::min(conf.offset_voiced, vad.offset_window - 1);
+    vad.preroll_frames =
+      std::max(std::min(conf.preroll_frames, size_t(KWS_MAX_PREROLL_FRAMES)),
+               size_t(1));
+  }
+  ESP_LOGD(TAG, "vad onset=%d/%d, offset=%d/%d, preroll=%d",
+           s_vad_conf.onset_voiced, s_vad_conf.onset_window,
+           s_vad_conf.offset_voiced, s_vad_conf.offset_window,
+           s_vad_conf.preroll_frames);
+}
+
+/*!
+ * \brief Apply configuration, rebuilds only the parts that changed.
+ * \param conf Configuration params.
+ * \return Result.
+ */
+static int frontend_configure(const kws_task_conf_t &conf) {
+  size_t decim = 1;
+#if CONFIG_KWS_HALF_RATE_FRONTEND
+  if (conf.mel_high_freq > 0 &&
+      conf.mel_high_freq <= CONFIG_MIC_SAMPLE_RATE / 2 / KWS_DECIM_FACTOR) {
+    decim = KWS_DECIM_FACTOR;
+  }
+#endif
+  const bool rate_changed = !s_agc_handle || decim != s_frontend.decim;
+  if (rate_changed) {
+    s_frontend.decim = decim;
+    s_frontend.sample_rate = CONFIG_MIC_SAMPLE_RATE / decim;
+    s_frontend.frame_len = MIC_FRAME_LEN / decim;
+    s_frontend.frame_sz = MIC_FRAME_SZ / decim;
+    s_capture.reset(s_frontend.frame_len);
+    s_decimator.reset();
+    s_gate.reset();
+    ESP_LOGD(TAG, "front end sample rate=%d", s_frontend.sample_rate);
+
+    if (s_agc_handle) {
+      esp_agc_close(s_agc_handle);
+    }
+    s_agc_handle = esp_agc_open(3, s_frontend.sample_rate);
+    if (!s_agc_handle) {
+      ESP_LOGE(TAG, "Unable to create agc");
+      return -1;
+    }
+  }
+  if (rate_changed || conf.mic_gain != s_conf.mic_gain) {
+    set_agc_config(s_agc_handle, conf.mic_gain, 1, 0);
+  }
+
+  if (rate_changed || !s_ns_handle || conf.ns_level != s_conf.ns_level) {
+    if (s_ns_handle) {
+      ns_destroy(s_ns_handle);
+    }
+    s_ns_handle =
+      ns_pro_create(AGC_FRAME_LEN_MS, conf.ns_level, s_frontend.sample_rate);
+    if (!s_ns_handle) {
+      ESP_LOGE(TAG, "Unable to create esp_ns");
+      return -1;
+    }
+  }
+
+  if (rate_changed || !s_kws_task_params.pp ||
+      conf.mel_low_freq != s_conf.mel_low_freq ||
+      conf.mel_high_freq != s_conf.mel_high_freq) {
+    delete s_kws_task_params.pp;
+    s_kws_task_params.pp = new AudioPreprocessor(
+      KWS_NUM_MFCC, KWS_FRAME_LEN / s_frontend.decim, KWS_NUM_FBANK_BINS,
+      conf.mel_low_freq, conf.mel_high_freq, s_frontend.sample_rate);
+  }
+  vad_configure(conf.vad);
+  s_kws_task_params.model_handle = conf.model_handle;
+  s_kws_task_params.screen_model_handle = conf.screen_model_handle;
+  s_kws_task_params.continuous = conf.continuous;
+  s_conf = conf;
+  return 0;
+}
+
+/*!
+ * \brief AGC and NS of a captured frame in place.
+ * \return Peak of the processed frame.
+ */
+static size_t clean_frame(audio_t *data) {
+  const int64_t t1 = esp_timer_get_time();
+  esp_agc_process(s_agc_handle, data, data, s_frontend.frame_len,
+                  s_frontend.sample_rate);
+  const int64_t t2 = esp_timer_get_time();
+  s_stats.agc_us += t2 - t1;
+  ns_process(s_ns_handle, data, data);
+  s_stats.ns_us += esp_timer_get_time() - t2;
+  return compute_max_abs(data, s_frontend.frame_len);
 }
 
 static void vad_task(void *pv) {
-  size_t max_abs_arr[DET_VOICED_FRAMES_WINDOW] = {0};
-  uint8_t is_speech_arr[DET_VOICED_FRAMES_WINDOW] = {0};
-  size_t cur_frame = 0;
-  size_t num_voiced = 0;
+  size_t max_abs_arr[KWS_CAPTURE_FRAMES] = {0};
+#if CONFIG_KWS_ENERGY_GATE
+  /*! \brief Frames the closed gate published without AGC and NS. */
+  uint8_t raw_arr[KWS_CAPTURE_FRAMES] = {0};
+#endif
+  uint8_t is_speech_arr[VAD_HISTORY_LEN] = {0};
+  size_t onset_voiced = 0;
+  size_t offset_voiced = 0;
   uint8_t trig = 0;
-  WordDesc_t word;
+  int64_t speech_end_us = 0;
+  int64_t mic_end_us = 0;
+  WordDesc_t word = {.start = 0, .frame_num = 0, .max_abs = 0};
 
+  alloc_zone_enter("vad");
   for (;;) {
-    const auto xBits =
-      xEventGroupWaitBits(xKWSEventGroup, VAD_RUNNING_MSK | VAD_STOP_MSK,
-                          pdFALSE, pdFALSE, portMAX_DELAY);
+    alloc_zone_check();
+    const auto xBits = xEventGroupWaitBits(
+      xKWSEventGroup, VAD_RUNNING_MSK | VAD_STOP_MSK | VAD_RECONF_MSK, pdFALSE,
+      pdFALSE, portMAX_DELAY);
 
     if (xBits & VAD_STOP_MSK) {
       break;
+    } else if (xBits & VAD_RECONF_MSK) {
+      // front end is swapped between frames, no locking needed
+      alloc_zone_exit();
+      s_reconf_res = frontend_configure(s_pending_conf);
+      alloc_zone_enter("vad");
+      memset(is_speech_arr, 0, sizeof(is_speech_arr));
+#if CONFIG_KWS_ENERGY_GATE
+      memset(raw_arr, 0, sizeof(raw_arr));
+#endif
+      onset_voiced = 0;
+      offset_voiced = 0;
+      trig = 0;
+      xEventGroupClearBits(xKWSEventGroup, VAD_RECONF_MSK);
+      xEventGroupSetBits(xKWSEventGroup, VAD_RECONF_DONE_MSK);
+      continue;
     } else if (!(xBits & VAD_RUNNING_MSK)) {
       continue;
     }
 
-    audio_t *proc_data =
-      &current_frames[(cur_frame % DET_VOICED_FRAMES_WINDOW) * MIC_FRAME_LEN];
+    const bool continuous = s_kws_task_params.continuous.enabled;
+    const kws_vad_conf_t &vad = s_vad_conf;
+    const size_t seq = s_capture.head();
+    audio_t *proc_data = s_capture.frame(seq);
+    audio_t *mic_data = s_frontend.decim > 1 ? full_rate_frame : proc_data;
+    const int64_t read_us = esp_timer_get_time();
     if (i2s_rx_slot_read(raw_data_buffer, sizeof(raw_data_buffer),
                          MIC_FRAME_LEN_MS) < 0) {
       continue;
     }
 
-    for (size_t i = 0; i < MIC_FRAME_LEN; i++) {
-      proc_data[i] = audio_t(raw_data_buffer[i] >> 16);
+    int64_t t1 = esp_timer_get_time();
+    const int64_t frame_us = t1;
+    mic_end_us = mic_frame_end(mic_end_us, read_us, t1);
+    convert_frame(mic_data, raw_data_buffer, MIC_FRAME_LEN);
+#if CONFIG_KWS_AEC
+    // playback echo is removed at the microphone rate, ahead of the gate
+    if (kws_aec_process(mic_data, MIC_FRAME_LEN, mic_end_us)) {
+      const int64_t t2 = esp_timer_get_time();
+      s_stats.aec_us += t2 - t1;
+      s_stats.aec_frames++;
+      t1 = t2;
+    }
+#endif
+    const frame_stats_t stats = analyze_frame(mic_data, MIC_FRAME_LEN);
+    if (s_frontend.decim > 1) {
+      s_decimator.proc_buffer(proc_data, full_rate_frame, MIC_FRAME_LEN);
     }
 
-    esp_agc_process(s_agc_handle, proc_data, proc_data, AGC_FRAME_LEN,
-                    CONFIG_MIC_SAMPLE_RATE);
+#if CONFIG_KWS_ENERGY_GATE
+    // a word in progress is cleaned as a whole, the gate may only skip
+    // frames between words
+    const bool gate_open =
+      s_gate.proc_frame(stats.energy, stats.zcr_q8) || continuous || trig;
+    raw_arr[seq % KWS_CAPTURE_FRAMES] = !gate_open;
+#else
+    const bool gate_open = true;
+#endif
+    s_stats.convert_us += esp_timer_get_time() - t1;
+    s_stats.frames++;
 
-    ns_process(s_ns_handle, proc_data, proc_data);
+    uint8_t is_speech = 0;
+    // replaced by the cleaned peak once the frame gets AGC and NS
+    size_t max_abs = stats.max_abs;
+    if (gate_open) {
+      s_stats.open_frames++;
+#if CONFIG_KWS_ENERGY_GATE
+      // pre-roll frames kept raw by the gate are cleaned before the frame
+      // that opened it, oldest first, so the word starts in one scale and NS
+      // sees the noise just before it
+      for (size_t k = seq - std::min(vad.preroll_frames, seq); k != seq; k++) {
+        if (raw_arr[k % KWS_CAPTURE_FRAMES]) {
+          raw_arr[k % KWS_CAPTURE_FRAMES] = 0;
+          max_abs_arr[k % KWS_CAPTURE_FRAMES] = clean_frame(s_capture.frame(k));
+        }
+      }
+#endif
+      max_abs = clean_frame(proc_data);
 
-    const auto vad_res = vad_process(s_vad_handle, proc_data,
-                                     CONFIG_MIC_SAMPLE_RATE, AGC_FRAME_LEN_MS);
-    const uint8_t is_speech = vad_res == VAD_SPEECH;
-    num_voiced += is_speech;
-    is_speech_arr[cur_frame % DET_VOICED_FRAMES_WINDOW] = is_speech;
+      if (!continuous) {
+        t1 = esp_timer_get_time();
+        const auto vad_res =
+          vad_process(s_vad_handle, proc_data, s_frontend.sample_rate,
+                      AGC_FRAME_LEN_MS);
+        is_speech = vad_res == VAD_SPEECH;
+        s_stats.vad_us += esp_timer_get_time() - t1;
+      }
+    }
+    max_abs_arr[seq % KWS_CAPTURE_FRAMES] = max_abs;
+    s_capture.publish();
 
-    const size_t max_abs = compute_max_abs(proc_data, MIC_FRAME_LEN);
+    if (continuous) {
+      notify_kws(KWS_NTF_DATA_MSK);
+      continue;
+    }
 
-    max_abs_arr[cur_frame % DET_VOICED_FRAMES_WINDOW] = max_abs;
+    // onset and offset windows slide over the same speech flags
+    is_speech_arr[seq % VAD_HISTORY_LEN] = is_speech;
+    onset_voiced += is_speech;
+    offset_voiced += is_speech;
+    if (seq >= vad.onset_window) {
+      onset_voiced -= is_speech_arr[(seq - vad.onset_window) % VAD_HISTORY_LEN];
+    }
+    if (seq >= vad.offset_window) {
+      offset_voiced -=
+        is_speech_arr[(seq - vad.offset_window) % VAD_HISTORY_LEN];
+    }
+    if (is_speech) {
+      speech_end_us = frame_us;
+    }
 
     if (!trig) {
-      if (num_voiced >= DET_VOICED_FRAMES_THRESHOLD) {
+      if (onset_voiced >= vad.onset_voiced) {
+        trig = 1;
+        const size_t preroll = std::min(vad.preroll_frames, seq + 1);
+        word.start = seq + 1 - preroll;
         word.frame_num = 0;
         word.max_abs = 0;
-        trig = 1;
-        ESP_LOGD(TAG, "__start[%d]=%d, max_abs=%d",
-                 cur_frame - DET_VOICED_FRAMES_WINDOW, cur_frame, max_abs);
-        for (size_t k = 1; k <= DET_VOICED_FRAMES_WINDOW; k++) {
-          const size_t frame_num = (cur_frame + k) % DET_VOICED_FRAMES_WINDOW;
-          audio_t *frame_ptr = &current_frames[frame_num * MIC_FRAME_LEN];
-          const auto xBytesSent =
-            xStreamBufferSend(xWordFramesBuffer, frame_ptr, MIC_FRAME_SZ, 0);
-          if (xBytesSent < MIC_FRAME_SZ) {
-            ESP_LOGW(TAG, "xWordFramesBuffer: xBytesSent=%d (%d)", xBytesSent,
-                     MIC_FRAME_SZ);
-          }
-          word.frame_num++;
-          word.max_abs = std::max(word.max_abs, max_abs_arr[frame_num]);
+        for (size_t k = word.start; k != seq + 1; k++) {
+          word.max_abs =
+            std::max(word.max_abs, max_abs_arr[k % KWS_CAPTURE_FRAMES]);
         }
-      }
-    } else {
-      if (num_voiced <= DET_UNVOICED_FRAMES_THRESHOLD) {
-        trig = 0;
-        ESP_LOGD(TAG, "__end[%d]=%d, max_abs=%d",
-                 cur_frame - DET_VOICED_FRAMES_WINDOW, cur_frame, max_abs);
+        // the previous word is released
+        s_capture.retain(word.start);
+        kws_latency_mark(KWS_LAT_VAD_START);
+        DLOGD(TAG, "__start[%d]=%d, max_abs=%d", word.start, seq,
+              word.max_abs);
         xQueueSend(xWordQueue, &word, 0);
-      } else {
-        word.frame_num++;
-        word.max_abs = std::max(word.max_abs, max_abs);
-        const auto xBytesSent =
-          xStreamBufferSend(xWordFramesBuffer, proc_data, MIC_FRAME_SZ, 0);
-        if (xBytesSent < MIC_FRAME_SZ) {
-          ESP_LOGW(TAG, "xWordFramesBuffer: xBytesSent=%d (%d)", xBytesSent,
-                   MIC_FRAME_SZ);
-        }
+        notify_kws(KWS_NTF_DATA_MSK);
       }
+    } else if (offset_voiced <= vad.offset_voiced) {
+      trig = 0;
+      word.frame_num = seq - word.start;
+      s_capture.retain_end(seq);
+      DLOGD(TAG, "__end[%d]=%d, max_abs=%d", word.start, seq, word.max_abs);
+      kws_latency_mark(KWS_LAT_SPEECH_END, speech_end_us);
+      kws_latency_mark(KWS_LAT_VAD_END);
+      xQueueSend(xWordQueue, &word, 0);
+      notify_kws(KWS_NTF_DATA_MSK);
+    } else {
+      word.max_abs = std::max(word.max_abs, max_abs);
+      notify_kws(KWS_NTF_DATA_MSK);
     }
-
-    num_voiced -= is_speech_arr[(cur_frame + 1) % DET_VOICED_FRAMES_WINDOW];
-
-    cur_frame++;
   }
 
+  alloc_zone_exit();
   ESP_LOGD(TAG, "stop vad_task");
   xEventGroupSetBits(xKWSEventGroup, VAD_STOPPED_MSK);
-  xVADTaskHandle = NULL;
-  vTaskDelete(NULL);
+  // static stack is reused by the next kws_task_init, deleted by release
+  vTaskSuspend(NULL);
 }
 
-void kws_task(void *pv) {
-  kws_task_param_t *params = static_cast<kws_task_param_t *>(pv);
+static bool seq_before(size_t a, size_t b) { return ptrdiff_t(a - b) < 0; }
+
+/*!
+ * \brief Skip frames overwritten by vad_task.
+ * \return Oldest readable frame not before seq.
+ */
+static size_t capture_catch_up(size_t seq) {
+  const size_t tail = s_capture.tail();
+  if (seq_before(seq, tail)) {
+    DLOGW(TAG, "capture overrun: skipped %d frames", tail - seq);
+    return tail;
+  }
+  return seq;
+}
+
+/*!
+ * \brief Pass captured frame to the MFCC stream.
+ * \return New MFCC frame was pushed.
+ */
+static bool feed_frame(AudioPreprocessor *preprocessor, size_t seq) {
+  const uint8_t *src = (const uint8_t *)s_capture.frame(seq);
+  const size_t frame_sz = s_frontend.frame_sz;
+  bool pushed = false;
+  for (size_t off = 0; off < frame_sz;) {
+    const size_t len = std::min(frame_sz - off, s_mfcc_stream.tail_len());
+    memcpy(s_mfcc_stream.tail(), &src[off], len);
+    pushed |= s_mfcc_stream.commit(preprocessor, len);
+    off += len;
+  }
+  return pushed;
+}
+
+static size_t argmax_keyword(const float *scores, size_t len) {
+  size_t idx = KWS_FILLER_LABELS_NUM;
+  for (size_t i = KWS_FILLER_LABELS_NUM; i < len; i++) {
+    if (scores[i] > scores[idx]) {
+      idx = i;
+    }
+  }
+  return idx;
+}
+
+/*!
+ * \brief Sliding window recognition, runs until the request is served or
+ * cancelled.
+ */
+static void recognize_continuous(kws_task_param_t *params, size_t req_words,
+                                 float *mfcc_buffer) {
   AudioPreprocessor *preprocessor = params->pp;
   nn_model_handle_t model = params->model_handle;
-  uint8_t proc_buf[PROC_BUF_SZ] = {0};
-  float mfcc_buffer[KWS_FRAME_NUM * KWS_NUM_MFCC];
+  const auto &conf = params->continuous;
+  const size_t stride = std::max(conf.stride_ms / KWS_STRIDE_MS, size_t(1));
+  const size_t refractory = conf.refractory_ms / KWS_STRIDE_MS;
+  const float threshold = nn_model_get_threshold(model);
 
-  xStreamBufferSetTriggerLevel(xWordFramesBuffer, KWS_FRAME_SHIFT_BYTES);
+  s_mfcc_stream.reset(KWS_FRAME_SHIFT_BYTES / s_frontend.decim);
+  s_smoother.reset(std::max(conf.smooth_window, size_t(1)));
 
-  for (;;) {
-    size_t req_words = 0;
-    xQueuePeek(xKWSRequestQueue, &req_words, portMAX_DELAY);
+  size_t since_inference = 0;
+  size_t hold = 0;
+  size_t seq = s_capture.head();
+  for (size_t det_words = 0; det_words < req_words;) {
+    if (!kws_req_active()) {
+      // canceled request
+      return;
+    }
+    if (seq == s_capture.head()) {
+      wait_kws_event();
+      continue;
+    }
+    seq = capture_catch_up(seq);
+    if (!feed_frame(preprocessor, seq++)) {
+      continue;
+    }
 
-    if (req_words > MAX_WORDS) {
-      ESP_LOGE(TAG, "req_words > MAX_WORDS");
+    if (hold) {
+      hold--;
     }
-    ESP_LOGD(TAG, "recogninze req_words=%d", req_words);
+    if (++since_inference < stride || !s_mfcc_ring.full()) {
+      continue;
+    }
+    since_inference = 0;
 
-    vad_start();
-    size_t det_words = 0;
-    for (; det_words < req_words;) {
-      WordDesc_t word = {.frame_num = 0, .max_abs = 0};
-      while (xQueueReceive(xWordQueue, &word, pdMS_TO_TICKS(1)) == pdFAIL) {
-        if (uxQueueMessagesWaiting(xKWSRequestQueue) == 0) {
-          // canceled request
-          xQueueReset(xKWSResultQueue);
-          break;
-        }
-      }
+    const int64_t t1 = esp_timer_get_time();
+    s_mfcc_ring.linearize(mfcc_buffer);
+    preprocessor->MfccNormalize(mfcc_buffer, KWS_FRAME_NUM,
+                                s_mfcc_ring.max_abs());
+
+    float scores[KWS_MAX_LABELS];
+    size_t labels_num = KWS_MAX_LABELS;
+    if (nn_model_predict(model, mfcc_buffer, KWS_FEATURES_LEN, scores,
+                         &labels_num) < 0) {
+      ESP_LOGE(TAG, "inference error");
+      continue;
+    }
+    const float *smoothed = s_smoother.push(scores, labels_num);
+    const int category = argmax_keyword(smoothed, labels_num);
+    DLOGV(TAG, "cont: %d=%f, %lld us", category, smoothed[category],
+          esp_timer_get_time() - t1);
+
+    if (hold || smoothed[category] <= threshold) {
+      continue;
+    }
+    char result[32] = {0};
+    nn_model_get_label(model, category, result, sizeof(result));
+    ESP_LOGI(TAG, ">> kws: %s", result);
+    xQueueSend(xKWSResultQueue, &category, 0);
+    xSemaphoreGive(xKWSSema);
+    hold = refractory;
+    s_smoother.reset();
+    det_words++;
+  }
+}
+
+/*!
+ * \brief Featurize word frames while the word is being spoken.
+ * \return Word descriptor, frame_num is 0 if request is cancelled.
+ */
+static WordDesc_t receive_word(AudioPreprocessor *preprocessor) {
+  WordDesc_t word = {.start = 0, .frame_num = 0, .max_abs = 0};
+  // word start, end of a word cut by previous request is skipped
+  for (;;) {
+    if (xQueueReceive(xWordQueue, &word, 0) == pdPASS) {
       if (word.frame_num == 0) {
-        goto CLEANUP;
-      } else if (word.frame_num > 0) {
-        ESP_LOGD(TAG, "got word: frame_num=%d, max_abs=%d", word.frame_num,
-                 word.max_abs);
+        break;
       }
+      continue;
+    }
+    if (!kws_req_active()) {
+      // canceled request
+      word.frame_num = 0;
+      return word;
+    }
+    wait_kws_event();
+  }
 
-      memset(proc_buf, 0, PROC_BUF_SZ);
-      memset(mfcc_buffer, 0, MFCC_BUF_SZ);
+  s_mfcc_stream.reset(KWS_FRAME_SHIFT_BYTES / s_frontend.decim);
+  size_t seq = word.start;
+  for (;;) {
+    const bool ended = xQueueReceive(xWordQueue, &word, 0) == pdPASS;
+    const size_t last = ended ? word.start + word.frame_num : s_capture.head();
+    seq = capture_catch_up(seq);
+    if (seq_before(last, seq)) {
+      seq = last;
+    }
+    for (; seq != last; seq++) {
+      feed_frame(preprocessor, seq);
+    }
+    if (ended) {
+      break;
+    }
+    if (!kws_req_active()) {
+      // canceled request
+      word.frame_num = 0;
+      return word;
+    }
+    wait_kws_event();
+  }
+  s_mfcc_stream.flush(preprocessor);
+  return word;
+}
 
-      const int64_t t1 = esp_timer_get_time();
-      const size_t mfcc_frames = std::min(
-        (word.frame_num + MFCC_PROC_FRAME_NUM - 1) / MFCC_PROC_FRAME_NUM,
-        size_t(KWS_FRAME_NUM));
-      ESP_LOGD(TAG, "mfcc_frames=%d", mfcc_frames);
+/*!
+ * \brief Wait until kws_infer_task has served all queued words.
+ * \param drop Discard words not yet started.
+ */
+static void infer_flush(bool drop) {
+  if (drop) {
+    xQueueReset(xKWSFeatureQueue);
+  }
+  s_word_block.flush = true;
+  xQueueSend(xKWSFeatureQueue, &s_word_block, portMAX_DELAY);
+  xSemaphoreTake(xKWSInferFlushSema, portMAX_DELAY);
+}
 
-      auto xReceivedBytes = xStreamBufferReceive(xWordFramesBuffer, proc_buf,
-                                                 KWS_FRAME_SHIFT_BYTES, 0);
-      ESP_LOGV(TAG, "recv bytes=%d", xReceivedBytes);
+/*!
+ * \brief Screen word with the small model if there is one, the full model
+ * runs only on a plausible keyword.
+ * \param params Task params.
+ * \param features Word features.
+ * \param category Inferred category.
+ * \return Result.
+ */
+static int cascade_inference(const kws_task_param_t *params,
+                             const float *features, int *category) {
+  nn_model_handle_t screen_model = params->screen_model_handle;
+  int64_t t1 = esp_timer_get_time();
+  if (screen_model) {
+    int screen_category = -1;
+    if (nn_model_inference(screen_model, features, KWS_FEATURES_LEN,
+                           &screen_category) < 0) {
+      return -1;
+    }
+    const int64_t t2 = esp_timer_get_time();
+    s_cascade_stats.words++;
+    s_cascade_stats.screen_us += t2 - t1;
+    t1 = t2;
+    if (screen_category < KWS_FILLER_LABELS_NUM) {
+      // filler labels share indices across models
+      s_cascade_stats.rejected++;
+      *category = screen_category;
+      return 0;
+    }
+  }
+  if (nn_model_inference(params->model_handle, features, KWS_FEATURES_LEN,
+                         category) < 0) {
+    return -1;
+  }
+  const int64_t us = esp_timer_get_time() - t1;
+  if (screen_model) {
+    s_cascade_stats.verify_us += us;
+  }
+  DLOGD(TAG, "inference=%lld us", us);
+  return 0;
+}
 
-      audio_t *half_proc_buf = (audio_t *)&proc_buf[KWS_FRAME_SHIFT_BYTES];
+static void kws_infer_task(void *pv) {
+  kws_task_param_t *params = static_cast<kws_task_param_t *>(pv);
+  alloc_zone_enter("kws_infer");
+  for (;;) {
+    alloc_zone_check();
+    xQueueReceive(xKWSFeatureQueue, &s_infer_block, portMAX_DELAY);
+    if (s_infer_block.flush) {
+      xSemaphoreGive(xKWSInferFlushSema);
+      continue;
+    }
+    nn_model_handle_t model = params->model_handle;
+    int category = -1;
+    if (cascade_inference(params, s_infer_block.features, &category) < 0) {
+      ESP_LOGE(TAG, "inference error");
+      continue;
+    }
+    if (!kws_req_active()) {
+      // canceled request
+      continue;
+    }
+    kws_latency_mark(KWS_LAT_INFERENCE);
+#if CONFIG_PRON_SCORE
+    // the result consumer reads it before requesting the next word
+    memcpy(&s_last_word, &s_infer_block, sizeof(s_last_word));
+#endif
+    char result[32] = {0};
+    nn_model_get_label(model, category, result, sizeof(result));
+    ESP_LOGI(TAG, ">> kws: %s", result);
+    xQueueSend(xKWSResultQueue, &category, 0);
+    xSemaphoreGive(xKWSSema);
+  }
+}
 
-      size_t proc_frames = 0;
-      for (; proc_frames < mfcc_frames;) {
-        const auto xReceivedBytes = xStreamBufferReceive(
-          xWordFramesBuffer, half_proc_buf, KWS_FRAME_SHIFT_BYTES, 0);
-        ESP_LOGV(TAG, "recv bytes=%d", xReceivedBytes);
+void kws_task(void *pv) {
+  kws_task_param_t *params = static_cast<kws_task_param_t *>(pv);
+  float *features = s_word_block.features;
 
-        preprocessor->MfccCompute((audio_t *)proc_buf,
-                                  &mfcc_buffer[proc_frames * KWS_NUM_MFCC],
-                                  word.max_abs);
+  alloc_zone_enter("kws");
+  for (;;) {
+    alloc_zone_check();
+    size_t req_words = 0;
+    xQueuePeek(xKWSRequestQueue, &req_words, portMAX_DELAY);
+    // params may be swapped by kws_task_reconfigure between requests
+    AudioPreprocessor *preprocessor = params->pp;
 
-        memmove(proc_buf, half_proc_buf, KWS_FRAME_SHIFT_BYTES);
-        memset(half_proc_buf, 0, KWS_FRAME_SHIFT_BYTES);
+    if (req_words > MAX_WORDS) {
+      ESP_LOGE(TAG, "req_words > MAX_WORDS");
+      req_words = MAX_WORDS;
+    }
+    ESP_LOGD(TAG, "recogninze req_words=%d", req_words);
 
-        if (xReceivedBytes == 0) {
-          break;
-        } else {
-          proc_frames++;
-        }
+    vad_start();
+    if (params->continuous.enabled) {
+      recognize_continuous(params, req_words, features);
+      goto CLEANUP;
+    }
+    // VAD keeps segmenting the next word while this one is classified
+    for (size_t det_words = 0; det_words < req_words; det_words++) {
+      const WordDesc_t word = receive_word(preprocessor);
+      if (word.frame_num == 0) {
+        goto CLEANUP;
       }
+      alloc_zone_check();
+      DLOGD(TAG, "got word: frame_num=%d, max_abs=%d, mfcc_frames=%d",
+            word.frame_num, word.max_abs, s_mfcc_ring.size());
 
-      memset(proc_buf, 0, PROC_BUF_SZ);
+      // long words keep their last second
+      const size_t mfcc_frames = s_mfcc_ring.size();
+      s_mfcc_ring.linearize(features);
+      preprocessor->MfccNormalize(features, mfcc_frames,
+                                  s_mfcc_ring.max_abs());
       for (size_t i = mfcc_frames; i < KWS_FRAME_NUM; i++) {
-        memcpy(&mfcc_buffer[i * KWS_NUM_MFCC], silence_mfcc_coeffs,
+        memcpy(&features[i * KWS_NUM_MFCC], silence_mfcc_coeffs,
                KWS_NUM_MFCC * sizeof(float));
       }
-      ESP_LOGD(TAG, "preproc %d frames[%d]=%lld us", KWS_FRAME_NUM, det_words,
-               esp_timer_get_time() - t1);
-
-      if (word.frame_num > WORD_BUF_FRAME_NUM) {
-        xStreamBufferReset(xWordFramesBuffer);
-        ESP_LOGD(TAG, "cleared %d frames", word.frame_num - WORD_BUF_FRAME_NUM);
-      }
-
-      char result[32] = {0};
-      int category = -1;
-      if (nn_model_inference(model, mfcc_buffer, KWS_FEATURES_LEN, &category) <
-          0) {
-        ESP_LOGE(TAG, "inference error");
-        continue;
-      }
-      nn_model_get_label(model, category, result, sizeof(result));
-      ESP_LOGI(TAG, ">> kws: %s", result);
-      xQueueSend(xKWSResultQueue, &category, 0);
-      xSemaphoreGive(xKWSSema);
-      det_words++;
+      kws_latency_mark(KWS_LAT_FEATURES);
+      s_word_block.flush = false;
+      s_word_block.frames = mfcc_frames;
+      xQueueSend(xKWSFeatureQueue, &s_word_block, portMAX_DELAY);
     }
 
   CLEANUP:
     vad_stop();
+    if (kws_req_active()) {
+      infer_flush(false);
+    } else {
+      // canceled request
+      infer_flush(true);
+      xQueueReset(xKWSResultQueue);
+      xQueueReset(xKWSSema);
+    }
+    kws_latency_drop_pending();
+    ESP_LOGD(TAG, "gate noise floor=%u", s_gate.noise_floor());
     xQueueReset(xWordQueue);
-    xStreamBufferReset(xWordFramesBuffer);
     xQueueReceive(xKWSRequestQueue, &req_words, 0);
     xEventGroupSetBits(xKWSEventGroup, KWS_STOPPED_MSK);
   }
@@ -281,20 +954,13 @@ int kws_task_init(kws_task_conf_t conf) {
            KWS_FRAME_LEN, KWS_FRAME_SHIFT, KWS_FRAME_NUM);
   ESP_LOGD(TAG, "KWS_FRAME_SZ=%d, KWS_FRAME_SHIFT_BYTES=%d", KWS_FRAME_SZ,
            KWS_FRAME_SHIFT_BYTES);
-  ESP_LOGD(TAG, "PROC_BUF_FRAME_NUM=%d, WORD_BUF_FRAME_NUM=%d",
-           PROC_BUF_FRAME_NUM, WORD_BUF_FRAME_NUM);
-
-  s_agc_handle = esp_agc_open(3, CONFIG_MIC_SAMPLE_RATE);
-  if (!s_agc_handle) {
-    ESP_LOGE(TAG, "Unable to create agc");
-    return -1;
-  }
-  set_agc_config(s_agc_handle, conf.mic_gain, 1, 0);
+  ESP_LOGD(TAG, "PROC_BUF_FRAME_NUM=%d, KWS_CAPTURE_FRAMES=%d",
+           PROC_BUF_FRAME_NUM, KWS_CAPTURE_FRAMES);
 
-  s_ns_handle =
-    ns_pro_create(AGC_FRAME_LEN_MS, conf.ns_level, CONFIG_MIC_SAMPLE_RATE);
-  if (!s_ns_handle) {
-    ESP_LOGE(TAG, "Unable to create esp_ns");
+  memset(&s_stats, 0, sizeof(s_stats));
+  s_cascade_stats = kws_cascade_stats_t{};
+  kws_aec_reset();
+  if (frontend_configure(conf) < 0) {
     return -1;
   }
 
@@ -304,55 +970,53 @@ int kws_task_init(kws_task_conf_t conf) {
     return -1;
   }
 
-  xWordQueue = xQueueCreate(MAX_WORDS, sizeof(WordDesc_t));
+  // start and end per word
+  xWordQueue = s_word_queue.create();
   if (xWordQueue == NULL) {
     ESP_LOGE(TAG, "Error creating word queue");
     return -1;
   }
-  xWordFramesBuffer = xStreamBufferCreate(WORD_BUF_SZ, MIC_FRAME_SZ);
-  if (xWordFramesBuffer == NULL) {
-    ESP_LOGE(TAG, "Error creating word stream buffer");
-    return -1;
-  }
-  xKWSSema = xSemaphoreCreateBinary();
+  xKWSSema = xSemaphoreCreateCountingStatic(MAX_WORDS, 0, &s_kws_sema);
   if (!xKWSSema) {
     ESP_LOGE(TAG, "Error creating xKWSSema");
     return -1;
   }
+  xKWSFeatureQueue = s_feature_queue.create();
+  if (xKWSFeatureQueue == NULL) {
+    ESP_LOGE(TAG, "Error creating KWS feature queue");
+    return -1;
+  }
+  xKWSInferFlushSema = xSemaphoreCreateBinaryStatic(&s_infer_flush_sema);
+  if (!xKWSInferFlushSema) {
+    ESP_LOGE(TAG, "Error creating xKWSInferFlushSema");
+    return -1;
+  }
 
-  xKWSResultQueue = xQueueCreate(MAX_WORDS, sizeof(int));
+  xKWSResultQueue = s_result_queue.create();
   if (xKWSResultQueue == NULL) {
     ESP_LOGE(TAG, "Error creating KWS result queue");
     return -1;
   }
-  xKWSRequestQueue = xQueueCreate(1, sizeof(size_t));
+  xKWSRequestQueue = s_request_queue.create();
   if (xKWSRequestQueue == NULL) {
     ESP_LOGE(TAG, "Error creating KWS word queue");
     return -1;
   }
-  xKWSEventGroup = xEventGroupCreate();
+  xKWSEventGroup = xEventGroupCreateStatic(&s_kws_event_group);
   if (xKWSEventGroup == NULL) {
     ESP_LOGE(TAG, "Error creating xKWSEventGroup");
     return -1;
   }
 
-  auto xReturned =
-    xTaskCreate(vad_task, "vad_task", configMINIMAL_STACK_SIZE + 1024 * 8, NULL,
-                2, &xVADTaskHandle);
-  if (xReturned != pdPASS) {
-    ESP_LOGE(TAG, "Error creating vad_task");
+  if (createTask(eTask::VAD, vad_task, NULL, &xVADTaskHandle) != pdPASS) {
     return -1;
   }
-
-  s_kws_task_params.pp =
-    new AudioPreprocessor(KWS_NUM_MFCC, KWS_FRAME_LEN, KWS_NUM_FBANK_BINS,
-                          conf.mel_low_freq, conf.mel_high_freq);
-  s_kws_task_params.model_handle = conf.model_handle;
-  xReturned =
-    xTaskCreate(kws_task, "kws_task", configMINIMAL_STACK_SIZE + 1024 * 8,
-                &s_kws_task_params, 1, &xKWSTaskHandle);
-  if (xReturned != pdPASS) {
-    ESP_LOGE(TAG, "Error creating kws_task");
+  if (createTask(eTask::KWS, kws_task, &s_kws_task_params, &xKWSTaskHandle) !=
+      pdPASS) {
+    return -1;
+  }
+  if (createTask(eTask::KWS_INFER, kws_infer_task, &s_kws_task_params,
+                 &xKWSInferTaskHandle) != pdPASS) {
     return -1;
   }
 
@@ -361,17 +1025,22 @@ int kws_task_init(kws_task_conf_t conf) {
 }
 
 void kws_task_release() {
+  log_stats();
+  log_cascade_stats();
+  kws_latency_dump();
+  dumpTaskStats();
+  alloc_track_dump();
   xEventGroupClearBits(xKWSEventGroup, KWS_RUNNING_MSK);
   kws_req_cancel();
+  kws_wait_idle();
 
   xEventGroupSetBits(xKWSEventGroup, VAD_STOP_MSK);
   xEventGroupWaitBits(xKWSEventGroup, VAD_STOPPED_MSK, pdFALSE, pdFALSE,
                       portMAX_DELAY);
 
-  if (xKWSTaskHandle) {
-    vTaskDelete(xKWSTaskHandle);
-    xKWSTaskHandle = NULL;
-  }
+  deleteTask(eTask::VAD, &xVADTaskHandle);
+  deleteTask(eTask::KWS, &xKWSTaskHandle);
+  deleteTask(eTask::KWS_INFER, &xKWSInferTaskHandle);
 
   if (s_agc_handle) {
     esp_agc_close(s_agc_handle);
@@ -390,14 +1059,18 @@ void kws_task_release() {
     vQueueDelete(xWordQueue);
     xWordQueue = NULL;
   }
-  if (xWordFramesBuffer) {
-    vStreamBufferDelete(xWordFramesBuffer);
-    xWordFramesBuffer = NULL;
-  }
   if (xKWSSema) {
     vSemaphoreDelete(xKWSSema);
     xKWSSema = NULL;
   }
+  if (xKWSFeatureQueue) {
+    vQueueDelete(xKWSFeatureQueue);
+    xKWSFeatureQueue = NULL;
+  }
+  if (xKWSInferFlushSema) {
+    vSemaphoreDelete(xKWSInferFlushSema);
+    xKWSInferFlushSema = NULL;
+  }
   if (xKWSRequestQueue) {
     vQueueDelete(xKWSRequestQueue);
     xKWSRequestQueue = NULL;
@@ -416,6 +1089,24 @@ void kws_task_release() {
   }
 }
 
+int kws_task_reconfigure(kws_task_conf_t conf) {
+  if (!xKWSEventGroup ||
+      !(xEventGroupGetBits(xKWSEventGroup) & KWS_RUNNING_MSK)) {
+    ESP_LOGE(TAG, "KWS task is not running");
+    return -1;
+  }
+  kws_req_cancel();
+  kws_wait_idle();
+
+  s_pending_conf = conf;
+  xEventGroupClearBits(xKWSEventGroup, VAD_RECONF_DONE_MSK);
+  xEventGroupSetBits(xKWSEventGroup, VAD_RECONF_MSK);
+  xEventGroupWaitBits(xKWSEventGroup, VAD_RECONF_DONE_MSK, pdTRUE, pdFALSE,
+                      portMAX_DELAY);
+  xQueueReset(xKWSResultQueue);
+  return s_reconf_res;
+}
+
 void kws_req_word(size_t req_words) {
   if (xEventGroupGetBits(xKWSEventGroup) & KWS_RUNNING_MSK) {
     xEventGroupWaitBits(xKWSEventGroup, KWS_STOPPED_MSK, pdTRUE, pdFALSE,
@@ -430,7 +1121,57 @@ void kws_req_cancel() {
   if (auto req_num = uxQueueMessagesWaiting(xKWSRequestQueue)) {
     ESP_LOGD(TAG, "cancelled %d requests", req_num);
     xQueueReset(xKWSRequestQueue);
+    notify_kws(KWS_NTF_CANCEL_MSK);
   }
+}
+
+bool kws_req_active() { return uxQueueMessagesWaiting(xKWSRequestQueue) > 0; }
+
+void kws_wait_idle() {
   xEventGroupWaitBits(xKWSEventGroup, KWS_STOPPED_MSK, pdFALSE, pdFALSE,
                       portMAX_DELAY);
 }
+
+const float *kws_word_features(size_t *frames) {
+#if CONFIG_PRON_SCORE
+  if (s_last_word.frames) {
+    *frames = s_last_word.frames;
+    return s_last_word.features;
+  }
+#endif
+  *frames = 0;
+  return NULL;
+}
+
+int kws_utterance_get(kws_utterance_t *utt) {
+  size_t start, end;
+  if (!s_capture.span(&utt->gen, &start, &end)) {
+    return -1;
+  }
+  // the front end is reconfigured only with the span released
+  utt->start = start;
+  utt->frames = end - start;
+  utt->frame_len = s_capture.frame_len();
+  utt->sample_rate = s_frontend.sample_rate;
+  return 0;
+}
+
+size_t kws_utterance_read(const kws_utterance_t *utt, size_t pos,
+                          int16_t *dst, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    const size_t frame = pos / utt->frame_len;
+    const size_t offset = pos % utt->frame_len;
+    if (frame >= utt->frames) {
+      break;
+    }
+    const size_t n = std::min(len - done, utt->frame_len - offset);
+    if (!s_capture.read_span(utt->gen, utt->start + frame, offset, &dst[done],
+                             n)) {
+      break;
+    }
+    done += n;
+    pos += n;
+  }
+  return done;
+}
@@ -5,7 +5,6 @@
 #include "freertos/event_groups.h"
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
-#include "freertos/stream_buffer.h"
 #include "freertos/task.h"
 
 #include "nn_model.h"
@@ -22,17 +21,27 @@
 
 #define KWS_FEATURES_LEN KWS_FRAME_NUM *KWS_NUM_MFCC
 
+#define KWS_MAX_LABELS        16
+#define KWS_FILLER_LABELS_NUM 2 // _silence_, _unknown_
+#define KWS_MAX_SMOOTH_WINDOW 8
+
+/*!
+ * \brief Word in the capture ring. Sent twice: on VAD trigger with frame_num
+ * 0 and on word end.
+ */
 struct WordDesc_t {
+  /*! \brief Sequence number of the first frame, pre-roll included. */
+  size_t start;
   size_t frame_num;
   size_t max_abs;
 };
 
-#define MAX_WORDS          1
-#define WORD_BUF_FRAME_NUM (MAX_WORDS * CONFIG_MIC_SAMPLE_RATE / MIC_FRAME_LEN)
-#define WORD_BUF_SZ        (WORD_BUF_FRAME_NUM * MIC_FRAME_SZ)
+#define MAX_WORDS 4
+// Capture ring covers pre-roll and KWS task lag.
+#define KWS_CAPTURE_FRAMES     48
+#define KWS_MAX_PREROLL_FRAMES 32
+#define KWS_MAX_VAD_WINDOW     32
 
-/*! \brief Global word frames buffer. */
-extern StreamBufferHandle_t xWordFramesBuffer;
 /*! \brief Global input word queue. */
 extern QueueHandle_t xWordQueue;
 /*! \brief Global KWS output semaphore. */
@@ -44,18 +53,53 @@ extern QueueHandle_t xKWSResultQueue;
 /*! \brief Global KWS event bits. */
 extern EventGroupHandle_t xKWSEventGroup;
 
-#define KWS_RUNNING_MSK BIT0
-#define KWS_STOPPED_MSK BIT1
-#define VAD_RUNNING_MSK BIT2
-#define VAD_STOPPED_MSK BIT3
-#define VAD_STOP_MSK    BIT4
+#define KWS_RUNNING_MSK     BIT0
+#define KWS_STOPPED_MSK     BIT1
+#define VAD_RUNNING_MSK     BIT2
+#define VAD_STOPPED_MSK     BIT3
+#define VAD_STOP_MSK        BIT4
+#define VAD_RECONF_MSK      BIT5
+#define VAD_RECONF_DONE_MSK BIT6
+
+/*!
+ * \brief Word segmentation. Zero onset_window selects defaults: 16 frames
+ * windows, onset at 8 voiced, offset at 2 voiced, 16 frames pre-roll.
+ */
+struct kws_vad_conf_t {
+  /*! \brief Word starts when onset_voiced of last onset_window frames are
+   * voiced. */
+  size_t onset_window;
+  size_t onset_voiced;
+  /*! \brief Word ends when at most offset_voiced of last offset_window
+   * frames are voiced. */
+  size_t offset_window;
+  size_t offset_voiced;
+  /*! \brief Frames up to the trigger one included in the word. */
+  size_t preroll_frames;
+};
+
+/*! \brief Always-on sliding window mode, bypasses VAD segmentation. */
+struct kws_continuous_conf_t {
+  bool enabled;
+  /*! \brief Inference stride. */
+  size_t stride_ms;
+  /*! \brief Number of inferences averaged per class. */
+  size_t smooth_window;
+  /*! \brief Detections are suppressed for this time after a detection. */
+  size_t refractory_ms;
+};
 
 struct kws_task_conf_t {
   nn_model_handle_t model_handle;
+  /*! \brief Optional small first stage model, words it classifies as silence
+   * or unknown skip model_handle. Not used in continuous mode. */
+  nn_model_handle_t screen_model_handle;
   int mic_gain;
   int ns_level;
   size_t mel_low_freq;
   size_t mel_high_freq;
+  kws_vad_conf_t vad;
+  kws_continuous_conf_t continuous;
 };
 
 /*!
@@ -64,19 +108,74 @@ struct kws_task_conf_t {
  * \return Result.
  */
 int kws_task_init(kws_task_conf_t conf);
+/*!
+ * \brief Swap configuration of running KWS task, only changed parts of the
+ * front end are rebuilt. Pending request is cancelled.
+ * \param conf Configuration params.
+ * \return Result.
+ */
+int kws_task_reconfigure(kws_task_conf_t conf);
 /*!
  * \brief Release KWS task.
  * \return Result.
  */
 void kws_task_release();
 /*!
- * \brief Request to recognize words.
+ * \brief Request to recognize words, up to MAX_WORDS. Results come in order,
+ * one xKWSSema count per word.
  * \param req_words Number of words.
  */
 void kws_req_word(size_t req_words);
 /*!
- * \brief Cancel request.
+ * \brief Cancel request, does not wait for KWS task to stop.
  */
 void kws_req_cancel();
+/*!
+ * \brief Check if request is being served.
+ * \return Request is active.
+ */
+bool kws_req_active();
+/*!
+ * \brief Wait until KWS task is done with the request.
+ */
+void kws_wait_idle();
+/*!
+ * \brief Get features of the last recognized word, kept with
+ * CONFIG_PRON_SCORE. Valid until the next word is recognized.
+ * \param frames Number of MFCC frames, KWS_NUM_MFCC coefficients each.
+ * \return Features, NULL when none are kept.
+ */
+const float *kws_word_features(size_t *frames);
+
+/*! \brief Last word retained with CONFIG_KWS_UTTERANCE_REPLAY. */
+struct kws_utterance_t {
+  /*! \brief Retention generation, reads fail once it is released. */
+  size_t gen;
+  /*! \brief Sequence number of the first frame, pre-roll included. */
+  size_t start;
+  size_t frames;
+  size_t frame_len;
+  uint32_t sample_rate;
+};
+
+/*!
+ * \brief Get the last word. Its frames are moved out of the capture ring
+ * instead of being overwritten, up to CONFIG_KWS_UTTERANCE_REPLAY_MS, and
+ * released when the next word starts.
+ * \param utt Word.
+ * \return 0 on success, -1 when no ended word is retained.
+ */
+int kws_utterance_get(kws_utterance_t *utt);
+/*!
+ * \brief Read samples of the retained word, any task.
+ * \param utt Word.
+ * \param pos Position in samples.
+ * \param dst Samples.
+ * \param len Max number of samples.
+ * \return Number of samples, less than len at the end of the retained
+ * frames or once the word is released.
+ */
+size_t kws_utterance_read(const kws_utterance_t *utt, size_t pos,
+                          int16_t *dst, size_t len);
 
 #endif // _KWS_TASK_H_
@@ -1,53 +1,42 @@
 #include "App.hpp"
 #include "Lcd_GC9D01N.hpp"
 #include "Status.hpp"
+#include "assets.h"
 #include "git_version.h"
 #include "sed_task.h"
 
 static constexpr char TAG[] = "SED";
-extern const unsigned char *sed_baby_cry_model_ptr;
-extern const char *sed_baby_cry_labels[];
-extern unsigned int sed_baby_cry_labels_num;
-
-extern const unsigned char *sed_glass_breaking_model_ptr;
-extern const char *sed_glass_breaking_labels[];
-extern unsigned int sed_glass_breaking_labels_num;
-
-extern const unsigned char *sed_bark_model_ptr;
-extern const char *sed_bark_labels[];
-extern unsigned int sed_bark_labels_num;
-
-extern const unsigned char *sed_coughing_model_ptr;
-extern const char *sed_coughing_labels[];
-extern unsigned int sed_coughing_labels_num;
-
 static nn_model_handle_t s_model_handle = NULL;
 
-struct {
-  const char *name;
-  const unsigned char *model_ptr;
-  const char **labels;
-  unsigned int labels_num;
-  int mic_gain;
-} static const model_desc {
 #if CONFIG_SOUND_EVENTS_BABY_CRY
-  .name = "baby_cry", .model_ptr = sed_baby_cry_model_ptr,
-  .labels = sed_baby_cry_labels, .labels_num = sed_baby_cry_labels_num,
-  .mic_gain = 25,
+#define SED_EVENT    "baby_cry"
+#define SED_MIC_GAIN 25
 #elif CONFIG_SOUND_EVENTS_GLASS_BREAKING
-  .name = "glass_breaking", .model_ptr = sed_glass_breaking_model_ptr,
-  .labels = sed_glass_breaking_labels,
-  .labels_num = sed_glass_breaking_labels_num, .mic_gain = 6,
+#define SED_EVENT    "glass_breaking"
+#define SED_MIC_GAIN 6
 #elif CONFIG_SOUND_EVENTS_BARK
-  .name = "bark", .model_ptr = sed_bark_model_ptr, .labels = sed_bark_labels,
-  .labels_num = sed_bark_labels_num, .mic_gain = 20,
+#define SED_EVENT    "bark"
+#define SED_MIC_GAIN 20
 #elif CONFIG_SOUND_EVENTS_COUGHING
-  .name = "coughing", .model_ptr = sed_coughing_model_ptr,
-  .labels = sed_coughing_labels, .labels_num = sed_coughing_labels_num,
-  .mic_gain = 25,
+#define SED_EVENT    "coughing"
+#define SED_MIC_GAIN 25
 #else
 #error "set sound events type"
 #endif
+
+static const char *s_labels[] = {"_silence_", "_unknown_", SED_EVENT};
+
+struct {
+  const char *name;
+  /*! \brief Model in the asset bundle, see main/CMakeLists.txt. */
+  const char *model;
+  const char **labels;
+  unsigned int labels_num;
+  int mic_gain;
+} static const model_desc {
+  .name = SED_EVENT, .model = "sed_" SED_EVENT, .labels = s_labels,
+  .labels_num = sizeof(s_labels) / sizeof(s_labels[0]),
+  .mic_gain = SED_MIC_GAIN,
 };
 
 namespace SED {
@@ -105,9 +94,15 @@ void releaseScenario(App *app) {
 
 void initScenario(App *app) {
   ESP_LOGI(TAG, "Entering SED (%s) scenairo", model_desc.name);
+  asset_t model;
+  if (assets_find(model_desc.model, ASSET_MODEL, &model) < 0) {
+    app->transition(nullptr);
+    return;
+  }
   int errors = nn_model_init(&s_model_handle,
                              nn_model_config_t{
-                               .model_ptr = model_desc.model_ptr,
+                               .model_ptr =
+                                 static_cast<const unsigned char *>(model.data),
                                .labels = model_desc.labels,
                                .labels_num = model_desc.labels_num,
                                .is_quantized = true,
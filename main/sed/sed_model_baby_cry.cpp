@@ -3951,11 +3951,3 @@ const unsigned char sed_baby_cry_ds_cnn_quantized_tflite[] = {
   0x0b, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x0c, 0x00, 0x00, 0x00,
   0x16, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x16
 };
-unsigned int sed_baby_cry_ds_cnn_quantized_tflite_len = 47408;
-const char *sed_baby_cry_labels[] = {
-  "_silence_",
-  "_unknown_",
-  "baby_cry",
-};
-unsigned int sed_baby_cry_labels_num = 3;
-const unsigned char *sed_baby_cry_model_ptr = sed_baby_cry_ds_cnn_quantized_tflite;
@@ -3951,11 +3951,3 @@ const unsigned char sed_bark_ds_cnn_quantized_tflite[] = {
   0x0b, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x0c, 0x00, 0x00, 0x00,
   0x16, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x16
 };
-unsigned int sed_bark_ds_cnn_quantized_tflite_len = 47408;
-const char *sed_bark_labels[] = {
-  "_silence_",
-  "_unknown_",
-  "bark",
-};
-unsigned int sed_bark_labels_num = 3;
-const unsigned char *sed_bark_model_ptr = sed_bark_ds_cnn_quantized_tflite;
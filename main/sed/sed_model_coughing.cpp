@@ -4058,11 +4058,3 @@ const unsigned char sed_coughing_ds_cnn_quantized_tflite[] = {
   0x00, 0x00, 0x04, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x16, 0x00, 0x00, 0x00,
   0x00, 0x00, 0x00, 0x16
 };
-unsigned int sed_coughing_ds_cnn_quantized_tflite_len = 48688;
-const char *sed_coughing_labels[] = {
-  "_silence_",
-  "_unknown_",
-  "coughing",
-};
-unsigned int sed_coughing_labels_num = 3;
-const unsigned char *sed_coughing_model_ptr = sed_coughing_ds_cnn_quantized_tflite;
@@ -4058,11 +4058,3 @@ const unsigned char sed_glass_breaking_ds_cnn_quantized_tflite[] = {
   0x00, 0x00, 0x04, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x16, 0x00, 0x00, 0x00,
   0x00, 0x00, 0x00, 0x16
 };
-unsigned int sed_glass_breaking_ds_cnn_quantized_tflite_len = 48688;
-const char *sed_glass_breaking_labels[] = {
-  "_silence_",
-  "_unknown_",
-  "glass_breaking",
-};
-unsigned int sed_glass_breaking_labels_num = 3;
-const unsigned char *sed_glass_breaking_model_ptr = sed_glass_breaking_ds_cnn_quantized_tflite;
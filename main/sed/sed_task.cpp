@@ -1,4 +1,8 @@
 #include "sed_task.h"
+#include "MemBudget.hpp"
+#include "Tasks.hpp"
+#include "alloc_track.h"
+#include "dlog.h"
 #include "audio_preprocessor.h"
 #include "i2s_rx_slot.h"
 
@@ -42,9 +46,19 @@ static TaskHandle_t xPPTaskHandle = NULL;
 static TaskHandle_t xSEDTaskHandle = NULL;
 static AudioPreprocessor *pp = NULL;
 
-static void read_frame(audio_t *dst) {
-  raw_audio_t raw_data_buffer[MIC_FRAME_LEN] = {0};
+static MEM_BUDGET(sed) raw_audio_t raw_data_buffer[MIC_FRAME_LEN];
+static MEM_BUDGET(sed) audio_t proc_frame[SED_FRAME_LEN];
+// pp_task rolling window and sed_task input
+static MEM_BUDGET(sed) float pp_mfcc_buffer[SED_FEATURES_LEN];
+static MEM_BUDGET(sed) float sed_mfcc_buffer[SED_FEATURES_LEN];
+
+static StaticStreamBuffer_t s_frames_buffer;
+static MEM_BUDGET(sed) uint8_t s_frames_storage[MFCC_DATA_BUFFER_SZ + 1];
+static StaticQueue_t s_result_queue;
+static uint8_t s_result_storage[sizeof(int)];
+static StaticEventGroup_t s_event_group;
 
+static void read_frame(audio_t *dst) {
   i2s_rx_slot_read(raw_data_buffer, sizeof(raw_data_buffer), portMAX_DELAY);
 
   for (size_t i = 0; i < MIC_FRAME_LEN; i++) {
@@ -54,8 +68,9 @@ static void read_frame(audio_t *dst) {
 
 static void pp_task(void *pv) {
   AudioPreprocessor *preprocessor = static_cast<AudioPreprocessor *>(pv);
-  audio_t proc_frame[SED_FRAME_LEN] = {0};
-  float mfcc_buffer[SED_FEATURES_LEN] = {0};
+  float *mfcc_buffer = pp_mfcc_buffer;
+  memset(proc_frame, 0, sizeof(proc_frame));
+  memset(pp_mfcc_buffer, 0, sizeof(pp_mfcc_buffer));
 
   audio_t *proc_buf = &proc_frame[0];
   audio_t *half_proc_buf = &proc_frame[SED_FRAME_SHIFT];
@@ -68,7 +83,9 @@ static void pp_task(void *pv) {
   }
 
   size_t frame_counter = 0;
+  alloc_zone_enter("sed_pp");
   for (;;) {
+    alloc_zone_check();
     for (size_t i = 0; i < SED_FRAME_SHIFT / AGC_FRAME_LEN; i++) {
       audio_t *ptr = &half_proc_buf[i * AGC_FRAME_LEN];
       read_frame(ptr);
@@ -86,8 +103,8 @@ static void pp_task(void *pv) {
     memmove(proc_frame, half_proc_buf, SED_FRAME_SHIFT_BYTES);
     memset(half_proc_buf, 0, SED_FRAME_SHIFT_BYTES);
 
-    ESP_LOGV(TAG, "pp_frame: %u(%u), %lld us", current_frame, frame_counter,
-             esp_timer_get_time() - t1);
+    DLOGV(TAG, "pp_frame: %u(%u), %lld us", current_frame, frame_counter,
+          esp_timer_get_time() - t1);
 
     if ((frame_counter + 1) >= SED_FRAME_NUM) {
       if (!(xEventGroupGetBits(xSEDEventGroup) & SED_STATUS_BUSY_MSK)) {
@@ -99,14 +116,14 @@ static void pp_task(void *pv) {
           const auto xBytesSent = xStreamBufferSend(xSEDFramesBuffer, frame_ptr,
                                                     MFCC_DATA_FRAME_SZ, 0);
           if (xBytesSent < MFCC_DATA_FRAME_SZ) {
-            ESP_LOGW(TAG, "xSEDFramesBuffer: xBytesSent=%d (%d)", xBytesSent,
-                     MFCC_DATA_FRAME_SZ);
+            DLOGW(TAG, "xSEDFramesBuffer: xBytesSent=%d (%d)", xBytesSent,
+                  MFCC_DATA_FRAME_SZ);
           }
         }
-        ESP_LOGV(TAG, "sent frames: [%d; %d]", frame_counter - SED_FRAME_NUM,
-                 frame_counter);
+        DLOGV(TAG, "sent frames: [%d; %d]", frame_counter - SED_FRAME_NUM,
+              frame_counter);
       }
-      ESP_LOGV(TAG, "skipped frame: %d", frame_counter);
+      DLOGV(TAG, "skipped frame: %d", frame_counter);
     }
 
     frame_counter++;
@@ -115,16 +132,18 @@ static void pp_task(void *pv) {
 
 void sed_task(void *pv) {
   nn_model_handle_t model_handle = static_cast<nn_model_handle_t>(pv);
-  float mfcc_buffer[SED_FEATURES_LEN] = {0};
+  float *mfcc_buffer = sed_mfcc_buffer;
 
   int cats_buffer[SED_WINDOW] = {-1};
   size_t num_det = 0;
   uint8_t trig = 0;
   i2s_rx_slot_start();
+  alloc_zone_enter("sed");
   for (size_t counter = 0;; counter++) {
+    alloc_zone_check();
     const auto xReceivedBytes = xStreamBufferReceive(
       xSEDFramesBuffer, mfcc_buffer, MFCC_DATA_BUFFER_SZ, portMAX_DELAY);
-    ESP_LOGV(TAG, "recv bytes=%d", xReceivedBytes);
+    DLOGV(TAG, "recv bytes=%d", xReceivedBytes);
 
     xEventGroupSetBits(xSEDEventGroup, SED_STATUS_BUSY_MSK);
     int category = -1;
@@ -165,18 +184,20 @@ int sed_task_init(sed_task_conf_t conf) {
   set_agc_config(s_agc_handle, conf.mic_gain, 1, 0);
 
   xSEDFramesBuffer =
-    xStreamBufferCreate(MFCC_DATA_BUFFER_SZ, MFCC_DATA_BUFFER_SZ);
+    xStreamBufferCreateStatic(MFCC_DATA_BUFFER_SZ, MFCC_DATA_BUFFER_SZ,
+                              s_frames_storage, &s_frames_buffer);
   if (xSEDFramesBuffer == NULL) {
     ESP_LOGE(TAG, "Error creating sed frames buffer");
     return -1;
   }
-  xSEDResultQueue = xQueueCreate(1, sizeof(int));
+  xSEDResultQueue =
+    xQueueCreateStatic(1, sizeof(int), s_result_storage, &s_result_queue);
   if (xSEDResultQueue == NULL) {
     ESP_LOGE(TAG, "Error creating SED result queue");
     return -1;
   }
 
-  xSEDEventGroup = xEventGroupCreate();
+  xSEDEventGroup = xEventGroupCreateStatic(&s_event_group);
   if (xSEDEventGroup == NULL) {
     ESP_LOGE(TAG, "Error creating xSEDEventGroup");
     return -1;
@@ -184,24 +205,19 @@ int sed_task_init(sed_task_conf_t conf) {
 
   pp = new AudioPreprocessor(10, SED_FRAME_LEN, SED_NUM_FBANK_BINS,
                              SED_MEL_LOW_FREQ, SED_MEL_HIGH_FREQ);
-  auto xReturned =
-    xTaskCreate(pp_task, "pp_task", configMINIMAL_STACK_SIZE + 1024 * 10, pp, 1,
-                &xPPTaskHandle);
-  if (xReturned != pdPASS) {
-    ESP_LOGE(TAG, "Error creating pp_task");
+  if (createTask(eTask::SED_PP, pp_task, pp, &xPPTaskHandle) != pdPASS) {
     return -1;
   }
-  xReturned =
-    xTaskCreate(sed_task, "sed_task", configMINIMAL_STACK_SIZE + 1024 * 10,
-                conf.model_handle, 1, &xSEDTaskHandle);
-  if (xReturned != pdPASS) {
-    ESP_LOGE(TAG, "Error creating sed_task");
+  if (createTask(eTask::SED, sed_task, conf.model_handle, &xSEDTaskHandle) !=
+      pdPASS) {
     return -1;
   }
   return 0;
 }
 
 void sed_task_release() {
+  dumpTaskStats();
+  alloc_track_dump();
   i2s_rx_slot_stop();
 
   if (s_agc_handle) {
@@ -220,14 +236,8 @@ void sed_task_release() {
     vEventGroupDelete(xSEDEventGroup);
     xSEDEventGroup = NULL;
   }
-  if (xPPTaskHandle) {
-    vTaskDelete(xPPTaskHandle);
-    xPPTaskHandle = NULL;
-  }
-  if (xSEDTaskHandle) {
-    vTaskDelete(xSEDTaskHandle);
-    xSEDTaskHandle = NULL;
-  }
+  deleteTask(eTask::SED_PP, &xPPTaskHandle);
+  deleteTask(eTask::SED, &xSEDTaskHandle);
   if (pp) {
     delete pp;
   }
@@ -1,9 +1,11 @@
 #include "App.hpp"
 #include "Lcd_GC9D01N.hpp"
+#include "assets.h"
 #include "freertos/portmacro.h"
 #include "freertos/projdefs.h"
 #include "git_version.h"
 #include "kws_event_task.h"
+#include "kws_latency.h"
 #include "kws_task.h"
 
 #define TITLE      "VoiceRelay"
@@ -12,10 +14,28 @@
 static constexpr char TAG[] = TITLE;
 
 static nn_model_handle_t s_model_handle = NULL;
+static nn_model_handle_t s_screen_model_handle = NULL;
+// lock toggle was requested by a recognized word
+static bool s_word_action = false;
 
-extern const unsigned char *kws_model_ptr;
-extern const char *kws_labels[];
-extern unsigned int kws_labels_num;
+static const char *s_kws_labels[] = {
+  "_silence_", "_unknown_", "robot", "stop", "start", "sleep", "slow", "six",
+};
+#if CONFIG_KWS_CASCADE
+// screening model classes, keyword or not
+static const char *s_kws_screen_labels[] = {
+  "_silence_",
+  "_unknown_",
+  "keyword",
+};
+#endif
+
+static void mark_word_action() {
+  if (s_word_action) {
+    kws_latency_mark(KWS_LAT_ACTION);
+    s_word_action = false;
+  }
+}
 
 namespace VoiceRelay {
 struct Suspended : State {
@@ -54,8 +74,10 @@ struct Suspended : State {
       char result[32] = {0};
       if (xQueueReceive(xKWSResultQueue, &category, pdMS_TO_TICKS(1000)) ==
           pdPASS) {
+        kws_latency_mark(KWS_LAT_EVENT);
         nn_model_get_label(s_model_handle, category, result, sizeof(result));
         if (strcmp(result, "robot") == 0) {
+          s_word_action = true;
           app->transition(back_state_);
           back_state_ = nullptr;
         } else {
@@ -66,7 +88,7 @@ struct Suspended : State {
       }
     } break;
     default:
-      if (uxQueueMessagesWaiting(xKWSRequestQueue) == 0) {
+      if (!kws_req_active()) {
         kws_req_word(1);
       }
       break;
@@ -86,6 +108,7 @@ struct Main : State {
     kws_req_word(1);
     gpio_set_level(LOCK_PIN, 1);
     gpio_set_level(LOCK_PIN_INV, 0);
+    mark_word_action();
     xEventGroupSetBits(xStatusEventGroup, STATUS_STATE_UNLOCKED_MSK);
     xTimerChangePeriod(xTimer, SUSPEND_AFTER_TICKS, 0);
     timer_val_s_ = float(SUSPEND_AFTER_TICKS * portTICK_PERIOD_MS) / 1000;
@@ -96,6 +119,7 @@ struct Main : State {
     xEventGroupClearBits(xStatusEventGroup, STATUS_STATE_UNLOCKED_MSK);
     gpio_set_level(LOCK_PIN, 0);
     gpio_set_level(LOCK_PIN_INV, 1);
+    mark_word_action();
     app->p_display->clear();
     app->p_display->send();
   }
@@ -106,8 +130,10 @@ struct Main : State {
       char result[32] = {0};
       if (xQueueReceive(xKWSResultQueue, &category, pdMS_TO_TICKS(1000)) ==
           pdPASS) {
+        kws_latency_mark(KWS_LAT_EVENT);
         nn_model_get_label(s_model_handle, category, result, sizeof(result));
         if (strcmp(result, "stop") == 0) {
+          s_word_action = true;
           app->transition(new Suspended(clone()));
         } else {
           kws_req_word(1);
@@ -124,7 +150,7 @@ struct Main : State {
       app->transition(new Suspended(clone()));
       break;
     default:
-      if (uxQueueMessagesWaiting(xKWSRequestQueue) == 0) {
+      if (!kws_req_active()) {
         kws_req_word(1);
       }
       break;
@@ -157,23 +183,73 @@ void releaseScenario(App *app) {
     nn_model_release(s_model_handle);
     s_model_handle = NULL;
   }
+  if (s_screen_model_handle) {
+    nn_model_release(s_screen_model_handle);
+    s_screen_model_handle = NULL;
+  }
 }
 
 void initScenario(App *app) {
-  int errors = (nn_model_init(&s_model_handle,
-                              nn_model_config_t{
-                                .model_ptr = kws_model_ptr,
-                                .labels = kws_labels,
-                                .labels_num = kws_labels_num,
-                                .is_quantized = false,
-                                .inference_threshold = KWS_INFERENCE_THRESHOLD,
-                              }) < 0);
+  asset_t model;
+  if (assets_find("kws", ASSET_MODEL, &model) < 0) {
+    app->transition(nullptr);
+    return;
+  }
+  const nn_model_config_t model_cfg = {
+    .model_ptr = static_cast<const unsigned char *>(model.data),
+    .labels = s_kws_labels,
+    .labels_num = sizeof(s_kws_labels) / sizeof(s_kws_labels[0]),
+    .is_quantized = false,
+    .inference_threshold = KWS_INFERENCE_THRESHOLD,
+  };
+#if CONFIG_NN_PLACEMENT_BENCHMARK
+  nn_model_benchmark(model_cfg, KWS_FEATURES_LEN,
+                     CONFIG_NN_PLACEMENT_BENCHMARK_ITERATIONS);
+#endif
+  int errors = nn_model_init(&s_model_handle, model_cfg) < 0;
+#if CONFIG_KWS_CASCADE
+  asset_t screen_model;
+  if (assets_find("kws_screen", ASSET_MODEL, &screen_model) < 0) {
+    errors++;
+  } else {
+    errors += nn_model_init(&s_screen_model_handle,
+                            nn_model_config_t{
+                              .model_ptr = static_cast<const unsigned char *>(
+                                screen_model.data),
+                              .labels = s_kws_screen_labels,
+                              .labels_num = sizeof(s_kws_screen_labels) /
+                                            sizeof(s_kws_screen_labels[0]),
+                              .is_quantized = true,
+                              .inference_threshold =
+                                KWS_SCREEN_INFERENCE_THRESHOLD,
+                            }) < 0;
+  }
+#endif
   errors += kws_task_init(kws_task_conf_t{
               .model_handle = s_model_handle,
+              .screen_model_handle = s_screen_model_handle,
               .mic_gain = 30,
               .ns_level = 2,
               .mel_low_freq = 20,
               .mel_high_freq = 4000,
+              // short onset window, pre-roll keeps the word start
+              .vad =
+                {
+                  .onset_window = 8,
+                  .onset_voiced = 5,
+                  .offset_window = 16,
+                  .offset_voiced = 2,
+                  .preroll_frames = 16,
+                },
+#if CONFIG_KWS_CONTINUOUS
+              .continuous =
+                {
+                  .enabled = true,
+                  .stride_ms = CONFIG_KWS_CONTINUOUS_STRIDE_MS,
+                  .smooth_window = 3,
+                  .refractory_ms = 1000,
+                },
+#endif
             }) < 0;
   errors += kws_event_task_init() < 0;
 
@@ -8184,16 +8184,3 @@ const unsigned char kws_ds_cnn_quantized_tflite[] = {
   0x0b, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x0c, 0x00, 0x00, 0x00,
   0x16, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x16
 };
-unsigned int kws_ds_cnn_quantized_tflite_len = 98204;
-const char *kws_labels[] = {
-  "_silence_",
-  "_unknown_",
-  "robot",
-  "stop",
-  "start",
-  "sleep",
-  "slow",
-  "six",
-};
-unsigned int kws_labels_num = 8;
-const unsigned char *kws_model_ptr = kws_ds_cnn_quantized_tflite;
\ No newline at end of file
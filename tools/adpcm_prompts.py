@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""Voice prompt bank encoder.
+
+Reads a C source of 16-bit PCM WAV arrays (main/VoiceMsgPlayer/*_samples.cpp)
+and writes the same arrays and tables with every WAV re-encoded as 4-bit
+IMA-ADPCM (WAVE_FORMAT_IMA_ADPCM, 256 bytes blocks). Each table also gets a
+<table>_index array of wav_prompt_t (data offset, length, rate, format), so
+the player never parses headers. Malformed WAVs are rejected. The build
+packs prompts with tools/pack_assets.py, which uses this encoder.
+
+usage: tools/adpcm_prompts.py voice_msg_samples.cpp out.cpp
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+ARRAY_RE = re.compile(r"const unsigned char (\w+)\[\] = \{([^}]*)\};")
+TABLE_RE = re.compile(r"const unsigned char \*(\w+)\[\] = \{([^}]*)\};")
+NUM_RE = re.compile(r"unsigned int \w+_num = [^;]*;")
+BYTE_RE = re.compile(r"0x([0-9a-fA-F]{2})")
+
+WAVE_FORMAT_PCM = 1
+WAVE_FORMAT_IMA_ADPCM = 0x11
+BLOCK_ALIGN = 256
+SAMPLES_PER_BLOCK = (BLOCK_ALIGN - 4) * 2 + 1
+# resampler range of the player, see Resampler.hpp
+MIN_RATE = 8000
+MAX_RATE = 48000
+
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8]
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41,
+    45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190,
+    209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499,
+    2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845,
+    8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350,
+    22385, 24623, 27086, 29794, 32767,
+]
+
+
+def riff_chunks(name, blob):
+    """Walk RIFF WAVE chunks, return {id: (offset, size)} of the bodies."""
+    if len(blob) < 12 or blob[:4] != b"RIFF" or blob[8:12] != b"WAVE":
+        raise ValueError(f"{name}: not a RIFF WAVE")
+    riff_end = 8 + struct.unpack_from("<I", blob, 4)[0]
+    if riff_end > len(blob):
+        raise ValueError(f"{name}: RIFF size {riff_end} past {len(blob)} bytes")
+    chunks = {}
+    pos = 12
+    while pos + 8 <= riff_end:
+        chunk_id, size = blob[pos:pos + 4], struct.unpack_from("<I", blob, pos + 4)[0]
+        if pos + 8 + size > riff_end:
+            raise ValueError(f"{name}: truncated {chunk_id!r} chunk")
+        chunks.setdefault(chunk_id, (pos + 8, size))
+        pos += 8 + size + (size & 1)
+    if b"fmt " not in chunks or b"data" not in chunks:
+        raise ValueError(f"{name}: no fmt or data chunk")
+    if chunks[b"fmt "][1] < 16:
+        raise ValueError(f"{name}: short fmt chunk")
+    if chunks[b"data"][1] == 0:
+        raise ValueError(f"{name}: empty data chunk")
+    return chunks
+
+
+def parse_fmt(blob, chunks):
+    """(format, channels, rate, block_align, bits) of the fmt chunk."""
+    audio_format, channels, rate, _, block_align, bits = struct.unpack_from(
+        "<HHIIHH", blob, chunks[b"fmt "][0])
+    return audio_format, channels, rate, block_align, bits
+
+
+def parse_pcm_wav(name, blob):
+    """Return (sample_rate, samples) of a PCM mono WAV."""
+    chunks = riff_chunks(name, blob)
+    audio_format, channels, rate, _, bits = parse_fmt(blob, chunks)
+    if audio_format != WAVE_FORMAT_PCM or channels != 1 or bits != 16:
+        raise ValueError(f"{name}: only 16-bit mono PCM is supported")
+    if not MIN_RATE <= rate <= MAX_RATE:
+        raise ValueError(f"{name}: {rate} Hz is out of {MIN_RATE}..{MAX_RATE}")
+    offset, size = chunks[b"data"]
+    data = blob[offset:offset + size // 2 * 2]
+    return rate, struct.unpack(f"<{len(data) // 2}h", data)
+
+
+def index_entry(name, wav):
+    """wav_prompt_t initializer of an encoded WAV."""
+    chunks = riff_chunks(name, wav)
+    audio_format, _, rate, block_align, _ = parse_fmt(wav, chunks)
+    offset, size = chunks[b"data"]
+    return f"  {{{offset}, {size}, {rate}, 0x{audio_format:04x}, {block_align}}}, // {name}"
+
+
+def encode_sample(state, sample):
+    predictor, index = state
+    step = STEP_TABLE[index]
+    diff = sample - predictor
+    nibble = 8 if diff < 0 else 0
+    diff = abs(diff)
+    vpdiff = step >> 3
+    for bit in (4, 2, 1):
+        if diff >= step:
+            nibble |= bit
+            diff -= step
+            vpdiff += step
+        step >>= 1
+    predictor += -vpdiff if nibble & 8 else vpdiff
+    state[0] = max(-32768, min(32767, predictor))
+    state[1] = max(0, min(88, index + INDEX_TABLE[nibble & 7]))
+    return nibble
+
+
+def encode_ima_adpcm(samples):
+    """Blocks of a 4-byte header (first sample, step index) and nibbles."""
+    out = bytearray()
+    state = [0, 0]
+    for start in range(0, len(samples), SAMPLES_PER_BLOCK):
+        block = list(samples[start:start + SAMPLES_PER_BLOCK])
+        if len(block) % 2 == 0:
+            # nibbles come in pairs, pad the last block
+            block.append(block[-1])
+        state[0] = block[0]
+        out += struct.pack("<hBB", block[0], state[1], 0)
+        for i in range(1, len(block), 2):
+            low = encode_sample(state, block[i])
+            high = encode_sample(state, block[i + 1])
+            out.append(low | high << 4)
+    return bytes(out)
+
+
+def ima_adpcm_wav(rate, samples):
+    """RIFF, 20 bytes fmt, fact, data."""
+    data = encode_ima_adpcm(samples)
+    byte_rate = rate * BLOCK_ALIGN // SAMPLES_PER_BLOCK
+    fmt = struct.pack("<HHIIHHHH", WAVE_FORMAT_IMA_ADPCM, 1, rate, byte_rate,
+                      BLOCK_ALIGN, 4, 2, SAMPLES_PER_BLOCK)
+    body = (b"WAVE" + b"fmt " + struct.pack("<I", len(fmt)) + fmt +
+            b"fact" + struct.pack("<II", 4, len(samples)) +
+            b"data" + struct.pack("<I", len(data)) + data)
+    return b"RIFF" + struct.pack("<I", len(body)) + body
+
+
+def c_array(name, blob):
+    lines = [f"const unsigned char {name}[] = {{"]
+    for i in range(0, len(blob), 12):
+        lines.append("  " + " ".join(f"0x{b:02x}," for b in blob[i:i + 12]))
+    lines.append("};")
+    lines.append(f"const unsigned int {name}_len = {len(blob)};")
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("src", help="C source with PCM WAV arrays")
+    parser.add_argument("dst", help="generated C source")
+    args = parser.parse_args()
+
+    with open(args.src) as f:
+        text = f.read()
+    out = [f"// Generated by tools/adpcm_prompts.py from {args.src.split('/')[-1]}",
+           '#include "Types.hpp"']
+    pcm_bytes = adpcm_bytes = 0
+    index = {}
+    for m in ARRAY_RE.finditer(text):
+        name = m.group(1)
+        blob = bytes(int(b, 16) for b in BYTE_RE.findall(m.group(2)))
+        try:
+            rate, samples = parse_pcm_wav(name, blob)
+        except ValueError as e:
+            sys.exit(f"{args.src}: {e}")
+        wav = ima_adpcm_wav(rate, samples)
+        pcm_bytes += len(blob)
+        adpcm_bytes += len(wav)
+        index[name] = index_entry(name, wav)
+        out.append(c_array(name, wav))
+    tables = list(TABLE_RE.finditer(text))
+    nums = NUM_RE.findall(text)
+    if adpcm_bytes == 0 or not tables or not nums:
+        sys.exit(f"{args.src}: no WAV arrays or sample table")
+    for table in tables:
+        names = re.findall(r"\w+", table.group(2))
+        missing = [n for n in names if n not in index]
+        if missing:
+            sys.exit(f"{args.src}: {table.group(1)} lists unknown {missing}")
+        out.append(table.group(0))
+        # same order as the table, looked up by prompt id
+        out.append(f"extern const wav_prompt_t {table.group(1)}_index[];")
+        out.append(f"const wav_prompt_t {table.group(1)}_index[] = {{")
+        out += [index[n] for n in names]
+        out.append("};")
+    out += nums
+
+    with open(args.dst, "w") as f:
+        f.write("\n".join(out) + "\n")
+    print(f"{args.src}: {pcm_bytes} -> {adpcm_bytes} bytes")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Deferred log decoder.
+
+Restores the text of "#D" records emitted by the dlog drain task (see
+components/dlog/dlog.h), format and %s strings are read from the
+application ELF by address. Other lines pass through unchanged.
+
+usage: idf.py monitor | tools/dlog_decode.py build/proj.elf
+       tools/dlog_decode.py build/proj.elf monitor.log
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+RECORD_RE = re.compile(r"#D((?: [0-9a-f]{1,8})+)")
+SPEC_RE = re.compile(
+    r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|z|j|t|L)?([diouxXeEfFgGaAcsp%])")
+LEVELS = "NEWIDV"
+HEADER_WORDS = 4
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+
+class Elf:
+    """Loadable sections of a 32-bit little endian ELF."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+        if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+            raise ValueError(f"{path}: not a 32-bit little endian ELF")
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", data, 0x2E)
+        self.sections = []
+        for i in range(shnum):
+            _, sh_type, flags, addr, offset, size = struct.unpack_from(
+                "<IIIIII", data, shoff + i * shentsize)
+            if flags & SHF_ALLOC and sh_type != SHT_NOBITS and addr:
+                self.sections.append((addr, data[offset:offset + size]))
+
+    def string(self, addr):
+        for start, blob in self.sections:
+            if start <= addr < start + len(blob):
+                end = blob.find(b"\0", addr - start)
+                return blob[addr - start:end].decode(errors="replace")
+        return None
+
+
+def signed(value, bits):
+    return value - (1 << bits) if value >> (bits - 1) else value
+
+
+def format_record(elf, words):
+    fmt_addr, tag_addr, stamp, meta = words[:HEADER_WORDS]
+    args = iter(words[HEADER_WORDS:])
+    fmt = elf.string(fmt_addr)
+    tag = elf.string(tag_addr) or f"<0x{tag_addr:08x}>"
+    if fmt is None:
+        return f"dlog: unknown format 0x{fmt_addr:08x}, stale ELF?"
+
+    def next_word():
+        return next(args, None)
+
+    def convert(m):
+        flags, width, prec, length, conv = m.groups()
+        if conv == "%":
+            return "%"
+        if width == "*":
+            width = str(signed(next_word() or 0, 32))
+        if prec == "*":
+            prec = str(signed(next_word() or 0, 32))
+        spec = "%" + flags + (width or "") + ("." + prec if prec else "")
+        word = next_word()
+        if word is None:
+            return "?"
+        if conv in "diouxX":
+            value = word
+            if length in ("ll", "j", "L"):
+                high = next_word()
+                value |= (high or 0) << 32
+                if conv in "di":
+                    value = signed(value, 64)
+            elif conv in "di":
+                value = signed(value, 32)
+            return (spec + conv.replace("u", "d")) % value
+        if conv in "eEfFgGaA":
+            value, = struct.unpack("<f", struct.pack("<I", word))
+            conv = "f" if conv in "aA" else conv
+            return (spec + conv) % value
+        if conv == "c":
+            return (spec + "c") % chr(word & 0xFF)
+        if conv == "p":
+            return (spec + "s") % f"0x{word:x}"
+        text = elf.string(word)
+        return (spec + "s") % (text if text is not None else f"<0x{word:08x}>")
+
+    level = LEVELS[meta & 0xFF] if (meta & 0xFF) < len(LEVELS) else "?"
+    core = (meta >> 16) & 0xFF
+    msg = SPEC_RE.sub(convert, fmt)
+    return f"{level} ({stamp / 1000:.3f}) {tag}: {msg} [core{core}]"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="application ELF, e.g. build/proj.elf")
+    parser.add_argument("log", nargs="?", help="serial log, stdin if omitted")
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    src = open(args.log, errors="replace") if args.log else sys.stdin
+    for line in src:
+        m = RECORD_RE.search(line)
+        if not m:
+            sys.stdout.write(line)
+            continue
+        words = [int(w, 16) for w in m.group(1).split()]
+        if len(words) < HEADER_WORDS:
+            sys.stdout.write(line)
+            continue
+        print(format_record(elf, words), flush=True)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
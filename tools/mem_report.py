@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Static RAM budget and task stack usage report.
+
+Sums the .bss.budget.<component> sections (see MEM_BUDGET in
+main/App/include/MemBudget.hpp) from the linker map and, when a serial log
+is given, the stack high water marks logged by deleteTask().
+
+usage: tools/mem_report.py build/proj.map [--log monitor.log]
+"""
+
+import argparse
+import re
+import sys
+from collections import defaultdict
+
+SECTION_RE = re.compile(r"^\s*\.bss\.budget\.(\w+)(?:\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S+))?")
+ENTRY_RE = re.compile(r"^\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S+)")
+STACK_RE = re.compile(r"stack (\S+): (\d+) of (\d+) bytes used")
+
+
+def parse_map(path):
+    budget = defaultdict(int)
+    objects = defaultdict(set)
+    pending = None
+    in_memory_map = False
+    with open(path, errors="replace") as f:
+        for line in f:
+            if not in_memory_map:
+                # skip discarded input sections
+                in_memory_map = line.startswith("Linker script and memory map")
+                continue
+            if pending:
+                m = ENTRY_RE.match(line)
+                if m:
+                    budget[pending] += int(m.group(2), 16)
+                    objects[pending].add(m.group(3).split("(")[-1].rstrip(")"))
+                pending = None
+                continue
+            m = SECTION_RE.match(line)
+            if not m:
+                continue
+            if m.group(3):
+                budget[m.group(1)] += int(m.group(3), 16)
+                objects[m.group(1)].add(m.group(4).split("(")[-1].rstrip(")"))
+            else:
+                # long section name, address and size on the next line
+                pending = m.group(1)
+    return budget, objects
+
+
+def parse_log(path):
+    stacks = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = STACK_RE.search(line)
+            if not m:
+                continue
+            name, used, size = m.group(1), int(m.group(2)), int(m.group(3))
+            prev_used = stacks.get(name, (0, size))[0]
+            stacks[name] = (max(used, prev_used), size)
+    return stacks
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map", help="linker map file, build/<project>.map")
+    parser.add_argument("--log", help="serial log with deleteTask() lines")
+    args = parser.parse_args()
+
+    budget, objects = parse_map(args.map)
+    if not budget:
+        sys.exit("no .bss.budget.* sections in " + args.map)
+
+    print("%-12s %8s  %s" % ("component", "bytes", "objects"))
+    for name in sorted(budget, key=budget.get, reverse=True):
+        print("%-12s %8d  %s" % (name, budget[name], " ".join(sorted(objects[name]))))
+    print("%-12s %8d" % ("total", sum(budget.values())))
+
+    if args.log:
+        stacks = parse_log(args.log)
+        print()
+        print("%-20s %6s %6s %6s" % ("task", "stack", "used", "spare"))
+        for name, (used, size) in sorted(stacks.items()):
+            print("%-20s %6d %6d %6d" % (name, size, used, size - used))
+        spare = sum(size - used for used, size in stacks.values())
+        print("%-20s %6s %6s %6d" % ("total", "", "", spare))
+
+
+if __name__ == "__main__":
+    main()
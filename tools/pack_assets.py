@@ -0,0 +1,313 @@
+#!/usr/bin/env python3
+"""Asset bundle packer.
+
+Packs models, voice prompt tables and XBM bitmaps of the configured scenario
+into one binary for the "assets" partition, see components/assets/assets.h.
+Sources stay the C arrays of the repo, they are parsed instead of compiled:
+
+  model:NAME=SRC     the single byte array of SRC, a TFLite flatbuffer
+  prompts:TABLE=SRC  PCM WAV arrays of SRC in the order of its pointer table,
+                     encoded as IMA-ADPCM. Each prompt is a WAV asset
+                     TABLE/<array>, TABLE is the wav_prompt_t index.
+  bitmaps:SRC        every <name>_bits array of SRC as bitmap <name>
+  mfcc:TABLE:LOW:HIGH=SRC
+                     reference MFCC frames of the prompts of SRC for the
+                     pronunciation score, asset TABLE.mfcc. Extracted as
+                     the KWS front end does with a LOW-HIGH Hz mel range,
+                     silence trimmed, mean removed, int8 per coefficient.
+
+The bundle is a 16 bytes header, the TOC sorted by name (name, type, offset,
+size, CRC-32) and the assets, 16 bytes aligned. The output is rewritten only
+when its content changes. Run by the main component build, see
+main/CMakeLists.txt.
+
+usage: tools/pack_assets.py assets.bin model:kws=voice_relay/model.cpp ...
+"""
+
+import argparse
+import cmath
+import math
+import os
+import re
+import struct
+import sys
+import zlib
+
+from adpcm_prompts import (ARRAY_RE, BYTE_RE, TABLE_RE, ima_adpcm_wav,
+                           parse_fmt, parse_pcm_wav, riff_chunks)
+
+# keep in sync with components/assets/assets.h
+MAGIC = 0x42414C4C
+VERSION = 1
+NAME_LEN = 32
+ALIGN = 16
+HEADER = struct.Struct("<IHHII")
+TOC_ENTRY = struct.Struct(f"<{NAME_LEN}sHHIII")
+# wav_prompt_t of main/VoiceMsgPlayer/Types.hpp
+WAV_PROMPT = struct.Struct("<IIIHH")
+
+ASSET_MODEL = 1
+ASSET_WAV = 2
+ASSET_PROMPT_INDEX = 3
+ASSET_BITMAP = 4
+ASSET_MFCC = 5
+
+# KWS front end of main/kws/kws_task.h
+KWS_SAMPLE_RATE = 16000
+KWS_NUM_MFCC = 10
+KWS_NUM_FBANK_BINS = 40
+KWS_FRAME_LEN = KWS_SAMPLE_RATE // 1000 * 40
+KWS_FRAME_SHIFT = KWS_SAMPLE_RATE // 1000 * 20
+KWS_FRAME_NUM = (1000 - 40) // 20 + 1
+# pron_ref_header_t and pron_ref_entry_t of main/eng_teacher/PronScore.h,
+# c0 is only used to trim silence
+PRON_REF_COEFFS = KWS_NUM_MFCC - 1
+PRON_REF_HEADER = struct.Struct(f"<HH{PRON_REF_COEFFS}f")
+PRON_REF_ENTRY = struct.Struct("<IHH")
+PRON_TRIM_C0 = 30.0
+
+
+def strip_suffix(name, suffix):
+    return name[:-len(suffix)] if name.endswith(suffix) else name
+
+
+class Asset:
+    def __init__(self, name, asset_type, blob):
+        if len(name.encode()) >= NAME_LEN:
+            raise ValueError(f"{name}: name longer than {NAME_LEN - 1}")
+        self.name = name
+        self.type = asset_type
+        self.blob = blob
+        self.offset = 0
+        # WAV assets of a prompt index, table order
+        self.prompts = None
+
+
+def c_arrays(src):
+    with open(src) as f:
+        text = f.read()
+    arrays = {m.group(1): bytes(int(b, 16) for b in BYTE_RE.findall(m.group(2)))
+              for m in ARRAY_RE.finditer(text)}
+    if not arrays:
+        raise ValueError(f"{src}: no byte arrays")
+    return text, arrays
+
+
+def model_assets(name, src):
+    _, arrays = c_arrays(src)
+    if len(arrays) != 1:
+        raise ValueError(f"{src}: expected one model array, got {len(arrays)}")
+    blob = next(iter(arrays.values()))
+    if blob[4:8] != b"TFL3":
+        raise ValueError(f"{src}: not a TFLite flatbuffer")
+    return [Asset(name, ASSET_MODEL, blob)]
+
+
+def prompt_assets(table, src):
+    text, arrays = c_arrays(src)
+    tables = list(TABLE_RE.finditer(text))
+    if len(tables) != 1:
+        raise ValueError(f"{src}: expected one prompt table")
+    names = re.findall(r"\w+", tables[0].group(2))
+    missing = [n for n in names if n not in arrays]
+    if missing:
+        raise ValueError(f"{src}: {tables[0].group(1)} lists unknown {missing}")
+    wavs = []
+    index = Asset(table, ASSET_PROMPT_INDEX, bytes(WAV_PROMPT.size * len(names)))
+    index.prompts = []
+    for n in names:
+        rate, samples = parse_pcm_wav(n, arrays[n])
+        wav = Asset(f"{table}/{strip_suffix(n.strip('_'), '_wav')}", ASSET_WAV,
+                    ima_adpcm_wav(rate, samples))
+        wavs.append(wav)
+        index.prompts.append(wav)
+    return [index] + wavs
+
+
+def bitmap_assets(src):
+    _, arrays = c_arrays(src)
+    return [Asset(strip_suffix(n, "_bits"), ASSET_BITMAP, blob)
+            for n, blob in arrays.items()]
+
+
+def fft(x):
+    """Radix-2 FFT, len(x) is a power of 2."""
+    n = len(x)
+    bits = n.bit_length() - 1
+    a = [complex(x[int(f"{i:0{bits}b}"[::-1], 2)]) for i in range(n)]
+    size = 2
+    while size <= n:
+        half = size // 2
+        twiddles = [cmath.exp(-2j * math.pi * k / size) for k in range(half)]
+        for start in range(0, n, size):
+            for k, w in enumerate(twiddles):
+                t = w * a[start + k + half]
+                a[start + k + half] = a[start + k] - t
+                a[start + k] += t
+        size *= 2
+    return a
+
+
+def mel_scale(freq):
+    return 1127.0 * math.log(1.0 + freq / 700.0)
+
+
+def mel_fbank(fft_len, low, high):
+    """{fft bin: weight} per mel bin, as AudioPreprocessor::CreateMelFbank."""
+    width = KWS_SAMPLE_RATE / fft_len
+    mel_low, mel_high = mel_scale(low), mel_scale(high)
+    delta = (mel_high - mel_low) / (KWS_NUM_FBANK_BINS + 1)
+    fbank = []
+    for b in range(KWS_NUM_FBANK_BINS):
+        left, center, right = (mel_low + (b + i) * delta for i in range(3))
+        weights = {}
+        for i in range(fft_len // 2):
+            mel = mel_scale(width * i)
+            if left < mel < right:
+                weights[i] = ((mel - left) / (center - left) if mel <= center
+                              else (right - mel) / (right - center))
+        fbank.append(weights)
+    return fbank
+
+
+def mfcc_frames(samples, low, high):
+    """MFCC frames as kws_task streams a word: frame shift chunks, the last
+    window closed with zeros, not normalized by max_abs."""
+    fft_len = 1 << (KWS_FRAME_LEN - 1).bit_length()
+    fbank = mel_fbank(fft_len, low, high)
+    window = [0.5 - 0.5 * math.cos(2 * math.pi * i / KWS_FRAME_LEN)
+              for i in range(KWS_FRAME_LEN)]
+    dct = [[math.sqrt(2.0 / KWS_NUM_FBANK_BINS)
+            * math.cos(math.pi / KWS_NUM_FBANK_BINS * (n + 0.5) * k)
+            for n in range(KWS_NUM_FBANK_BINS)] for k in range(KWS_NUM_MFCC)]
+    x = list(samples) + [0] * (-len(samples) % KWS_FRAME_SHIFT + KWS_FRAME_SHIFT)
+    frames = []
+    for pos in range(0, len(x) - KWS_FRAME_SHIFT, KWS_FRAME_SHIFT):
+        frame = [v * w for v, w in zip(x[pos:pos + KWS_FRAME_LEN], window)]
+        spectrum = fft(frame + [0.0] * (fft_len - KWS_FRAME_LEN))
+        magnitude = [abs(c) for c in spectrum[:fft_len // 2]]
+        # FLT_MIN floor of AudioPreprocessor::LogMelCompute
+        log_mel = [math.log(sum(magnitude[i] * w for i, w in f.items())
+                            or 1.17549435e-38) for f in fbank]
+        frames.append([sum(d * v for d, v in zip(row, log_mel)) for row in dct])
+    return frames
+
+
+def pron_features(frames):
+    """Trim frames more than PRON_TRIM_C0 below the loudest at both ends,
+    keep the last second and remove the mean, as pron_score does."""
+    top = max(f[0] for f in frames)
+    voiced = [i for i, f in enumerate(frames) if f[0] >= top - PRON_TRIM_C0]
+    frames = frames[voiced[0]:voiced[-1] + 1][-KWS_FRAME_NUM:]
+    mean = [sum(f[k] for f in frames) / len(frames)
+            for k in range(1, KWS_NUM_MFCC)]
+    return [[v - m for v, m in zip(f[1:], mean)] for f in frames]
+
+
+def mfcc_assets(table, low, high, src):
+    text, arrays = c_arrays(src)
+    tables = list(TABLE_RE.finditer(text))
+    if len(tables) != 1:
+        raise ValueError(f"{src}: expected one prompt table")
+    prompts = []
+    for n in re.findall(r"\w+", tables[0].group(2)):
+        if n not in arrays:
+            raise ValueError(f"{src}: {tables[0].group(1)} lists unknown {n}")
+        rate, samples = parse_pcm_wav(n, arrays[n])
+        if rate != KWS_SAMPLE_RATE:
+            raise ValueError(f"{n}: {rate} Hz, features need {KWS_SAMPLE_RATE}")
+        prompts.append(pron_features(mfcc_frames(samples, low, high)))
+    scales = [max(abs(f[k]) for p in prompts for f in p) / 127 or 1.0
+              for k in range(PRON_REF_COEFFS)]
+    offset = PRON_REF_HEADER.size + PRON_REF_ENTRY.size * len(prompts)
+    entries = b""
+    data = b""
+    for p in prompts:
+        entries += PRON_REF_ENTRY.pack(offset + len(data), len(p), 0)
+        data += bytes(round(v / s) & 0xFF for f in p for v, s in zip(f, scales))
+    blob = PRON_REF_HEADER.pack(len(prompts), PRON_REF_COEFFS, *scales)
+    return [Asset(f"{table}.mfcc", ASSET_MFCC, blob + entries + data)]
+
+
+def prompt_index(index):
+    """wav_prompt_t array once the WAV offsets are known."""
+    out = b""
+    for wav in index.prompts:
+        chunks = riff_chunks(wav.name, wav.blob)
+        audio_format, _, rate, block_align, _ = parse_fmt(wav.blob, chunks)
+        offset, size = chunks[b"data"]
+        out += WAV_PROMPT.pack(wav.offset + offset, size, rate, audio_format,
+                               block_align)
+    return out
+
+
+def pack(assets):
+    names = [a.name for a in assets]
+    dups = {n for n in names if names.count(n) > 1}
+    if dups:
+        raise ValueError(f"duplicate assets {sorted(dups)}")
+    # sorted TOC, looked up by binary search; strcmp order is byte order
+    assets = sorted(assets, key=lambda a: a.name.encode())
+    pos = HEADER.size + TOC_ENTRY.size * len(assets)
+    for a in assets:
+        pos = (pos + ALIGN - 1) // ALIGN * ALIGN
+        a.offset = pos
+        pos += len(a.blob)
+    for a in assets:
+        if a.prompts is not None:
+            a.blob = prompt_index(a)
+    toc = b"".join(
+        TOC_ENTRY.pack(a.name.encode(), a.type, 0, a.offset, len(a.blob),
+                       zlib.crc32(a.blob)) for a in assets)
+    out = bytearray(HEADER.pack(MAGIC, VERSION, len(assets), pos,
+                                zlib.crc32(toc)) + toc)
+    for a in assets:
+        out += bytes(a.offset - len(out)) + a.blob
+    return bytes(out), assets
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("dst", help="bundle")
+    parser.add_argument("assets", nargs="+", help="TYPE:[NAME=]SRC")
+    parser.add_argument("--size", type=lambda s: int(s, 0),
+                        help="partition size to check against")
+    args = parser.parse_args()
+
+    assets = []
+    try:
+        for spec in args.assets:
+            kind, _, rest = spec.partition(":")
+            name, _, src = rest.rpartition("=")
+            if kind == "model" and name:
+                assets += model_assets(name, src)
+            elif kind == "prompts" and name:
+                assets += prompt_assets(name, src)
+            elif kind == "bitmaps" and not name:
+                assets += bitmap_assets(src)
+            elif kind == "mfcc" and name.count(":") == 2:
+                table, low, high = name.split(":")
+                assets += mfcc_assets(table, int(low), int(high), src)
+            else:
+                raise ValueError(f"{spec}: unknown asset spec")
+        bundle, assets = pack(assets)
+    except ValueError as e:
+        sys.exit(f"pack_assets: {e}")
+    if args.size is not None and len(bundle) > args.size:
+        sys.exit(f"pack_assets: {len(bundle)} bytes do not fit {args.size}")
+
+    old = None
+    if os.path.exists(args.dst):
+        with open(args.dst, "rb") as f:
+            old = f.read()
+    if old != bundle:
+        with open(args.dst, "wb") as f:
+            f.write(bundle)
+    for a in assets:
+        print(f"  {a.name:<32} type={a.type} offset={a.offset} size={len(a.blob)}")
+    print(f"{args.dst}: {len(assets)} assets, {len(bundle)} bytes"
+          + ("" if old != bundle else ", unchanged"))
+
+
+if __name__ == "__main__":
+    main()